@@ -1,19 +1,29 @@
 #include <jni.h>
+#include <fbjni/fbjni.h>
+#include <ReactCommon/CallInvokerHolder.h>
 #include "../cpp/react-native-leveldb.h"
 #include <android/log.h>
 
+using namespace facebook;
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void*) {
+  return jni::initialize(vm, [] {});
+}
+
 extern "C"
 JNIEXPORT void JNICALL
-Java_com_reactnativeleveldb_LeveldbModule_initialize(JNIEnv* env, jclass clazz, jlong jsiPtr, jstring docDir) {
+Java_com_reactnativeleveldb_LeveldbModule_initialize(JNIEnv* env, jclass clazz, jlong jsiPtr, jobject jsCallInvokerHolder, jstring docDir) {
   const char *cstr = env->GetStringUTFChars(docDir, NULL);
   std::string str = std::string(cstr);
   env->ReleaseStringUTFChars(docDir, cstr);
   __android_log_print(ANDROID_LOG_VERBOSE, "react-native-leveldb", "Initializing react-native-leveldb with document dir %s", str.c_str());
-  installLeveldb(*reinterpret_cast<facebook::jsi::Runtime*>(jsiPtr), std::string(str));
+  auto callInvoker = jni::alias_ref<react::CallInvokerHolder::javaobject>{
+      reinterpret_cast<react::CallInvokerHolder::javaobject>(jsCallInvokerHolder)}->cthis()->getCallInvoker();
+  installLeveldb(*reinterpret_cast<facebook::jsi::Runtime*>(jsiPtr), std::string(str), callInvoker);
 }
 
 extern "C"
 JNIEXPORT void JNICALL
-Java_com_reactnativeleveldb_LeveldbModule_destruct(JNIEnv* env, jclass clazz) {
-  cleanupLeveldb();
+Java_com_reactnativeleveldb_LeveldbModule_destruct(JNIEnv* env, jclass clazz, jlong jsiPtr) {
+  cleanupLeveldb(*reinterpret_cast<facebook::jsi::Runtime*>(jsiPtr));
 }
\ No newline at end of file
@@ -7,11 +7,15 @@ import com.facebook.react.bridge.ReactContextBaseJavaModule;
 import android.util.Log;
 import com.facebook.react.bridge.ReactMethod;
 import com.facebook.react.module.annotations.ReactModule;
+import com.facebook.react.turbomodule.core.CallInvokerHolderImpl;
 
 @ReactModule(name = LeveldbModule.NAME)
 public class LeveldbModule extends ReactContextBaseJavaModule {
   public static final String NAME = "Leveldb";
 
+  // The runtime that the bindings were installed on, 0 until then.
+  private long jsiPtr = 0;
+
   static {
     Log.i(NAME, "Loading C++ library...");
     System.loadLibrary("react-native-leveldb");
@@ -31,9 +35,11 @@ public class LeveldbModule extends ReactContextBaseJavaModule {
   public boolean install() {
     try {
       JavaScriptContextHolder jsContext = getReactApplicationContext().getJavaScriptContextHolder();
+      CallInvokerHolderImpl jsCallInvokerHolder = (CallInvokerHolderImpl) getReactApplicationContext().getCatalystInstance().getJSCallInvokerHolder();
       String directory = getReactApplicationContext().getFilesDir().getAbsolutePath();
       Log.i(NAME, "Initializing leveldb with directory " + directory);
-      LeveldbModule.initialize(jsContext.get(), directory);
+      jsiPtr = jsContext.get();
+      LeveldbModule.initialize(jsiPtr, jsCallInvokerHolder, directory);
       Log.i(NAME, "Successfully installed!");
       return true;
     } catch (Exception exception) {
@@ -42,13 +48,16 @@ public class LeveldbModule extends ReactContextBaseJavaModule {
     }
   }
 
-  private static native void initialize(long jsiPtr, String docDir);
+  private static native void initialize(long jsiPtr, CallInvokerHolderImpl jsCallInvokerHolder, String docDir);
 
-  private static native void destruct();
+  private static native void destruct(long jsiPtr);
 
   @Override
   public void onCatalystInstanceDestroy() {
     Log.i("Leveldb", "Closing all leveldb iterators and instances");
-    LeveldbModule.destruct();
+    if (jsiPtr != 0) {
+      LeveldbModule.destruct(jsiPtr);
+      jsiPtr = 0;
+    }
   }
 }
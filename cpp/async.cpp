@@ -0,0 +1,163 @@
+#include "async.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Async {
+
+namespace {
+
+class WorkerPool {
+ public:
+  WorkerPool() {
+    unsigned int threads = std::max(2u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < threads; i++) {
+      std::thread(&WorkerPool::work, this).detach();
+    }
+  }
+
+  void run(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  void work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !tasks_.empty(); });
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+};
+
+WorkerPool& pool() {
+  // Never destroyed: the detached workers may outlive static destructors at exit.
+  static WorkerPool* pool = new WorkerPool();
+  return *pool;
+}
+
+jsi::Value newError(jsi::Runtime& runtime, const std::string& message) {
+  return runtime.global().getPropertyAsFunction(runtime, "Error").callAsConstructor(runtime, jsi::String::createFromUtf8(runtime, message));
+}
+
+}  // namespace
+
+void run(std::function<void()> task) {
+  pool().run(std::move(task));
+}
+
+void parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+  if (n == 0) {
+    return;
+  }
+  struct State {
+    explicit State(const std::function<void(size_t)>& fn) : fn(fn) {}
+    const std::function<void(size_t)>& fn;
+    std::atomic<size_t> next{0};
+    size_t done = 0;
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+  // Helpers may only start after this returns, once there's nothing left to pick up: they hold on to the state, but
+  // don't call `fn` then.
+  auto state = std::make_shared<State>(fn);
+  auto work = [state, n]() {
+    size_t i;
+    while ((i = state->next.fetch_add(1)) < n) {
+      state->fn(i);
+      std::lock_guard<std::mutex> lock(state->mutex);
+      if (++state->done == n) {
+        state->cv.notify_all();
+      }
+    }
+  };
+
+  unsigned int helpers = std::min<size_t>(n, std::max(2u, std::thread::hardware_concurrency())) - 1;
+  for (unsigned int i = 0; i < helpers; i++) {
+    run(work);
+  }
+  work();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&] { return state->done == n; });
+}
+
+std::shared_ptr<jsi::Value> share(jsi::Runtime& runtime, const JsInvoker& invoker, const jsi::Value& value) {
+  JsInvoker deleteOn = invoker;
+  return std::shared_ptr<jsi::Value>(new jsi::Value(runtime, value), [deleteOn](jsi::Value* v) {
+    deleteOn->invokeAsync([v]() { delete v; });
+  });
+}
+
+void callLater(jsi::Runtime& runtime, const JsInvoker& invoker, const std::shared_ptr<jsi::Value>& callback,
+               std::function<std::vector<jsi::Value>(jsi::Runtime&)> args) {
+  if (!callback) {
+    return;
+  }
+  invoker->invokeAsync([&runtime, callback, args]() {
+    if (!callback->isObject() || !callback->asObject(runtime).isFunction(runtime)) {
+      return;
+    }
+    std::vector<jsi::Value> values = args(runtime);
+    callback->asObject(runtime).asFunction(runtime).call(runtime, values.data(), values.size());
+  });
+}
+
+jsi::Value promise(jsi::Runtime& runtime, const JsInvoker& invoker, std::function<Resolver()> job) {
+  auto executor = jsi::Function::createFromHostFunction(
+      runtime,
+      jsi::PropNameID::forAscii(runtime, "executor"),
+      2,  // resolve, reject
+      [invoker, job](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        auto resolve = share(runtime, invoker, arguments[0]);
+        auto reject = share(runtime, invoker, arguments[1]);
+        run([&runtime, invoker, job, resolve, reject]() {
+          Resolver resolver;
+          std::string error;
+          try {
+            resolver = job();
+          } catch (const std::exception& e) {
+            error = e.what();
+          }
+
+          invoker->invokeAsync([&runtime, resolver, error, resolve, reject]() {
+            if (!resolver) {
+              reject->asObject(runtime).asFunction(runtime).call(runtime, newError(runtime, error));
+              return;
+            }
+            jsi::Value result;
+            try {
+              result = resolver(runtime);
+            } catch (const jsi::JSError& e) {
+              reject->asObject(runtime).asFunction(runtime).call(runtime, newError(runtime, e.getMessage()));
+              return;
+            } catch (const std::exception& e) {
+              reject->asObject(runtime).asFunction(runtime).call(runtime, newError(runtime, e.what()));
+              return;
+            }
+            resolve->asObject(runtime).asFunction(runtime).call(runtime, std::move(result));
+          });
+        });
+        return jsi::Value::undefined();
+      });
+
+  return runtime.global().getPropertyAsFunction(runtime, "Promise").callAsConstructor(runtime, std::move(executor));
+}
+
+}  // namespace Async
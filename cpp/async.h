@@ -0,0 +1,41 @@
+#ifndef async_h
+#define async_h
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <jsi/jsi.h>
+#include <ReactCommon/CallInvoker.h>
+
+using namespace facebook;
+
+// Helpers to run work off the JS thread. JSI values must only be touched on the JS thread: jobs running on the worker
+// pool get back to it through the runtime's CallInvoker.
+namespace Async {
+  using JsInvoker = std::shared_ptr<react::CallInvoker>;
+  // Produces the value a promise resolves with. Called on the JS thread.
+  using Resolver = std::function<jsi::Value(jsi::Runtime&)>;
+
+  // Runs `job` on the worker pool and returns a Promise. The promise resolves with the value produced by the Resolver
+  // that `job` returns, or rejects with the message of a std::exception thrown by `job` or the Resolver.
+  jsi::Value promise(jsi::Runtime& runtime, const JsInvoker& invoker, std::function<Resolver()> job);
+
+  // Wraps a JSI value so that it can be captured by jobs: whichever thread drops the last reference, the value itself
+  // is destroyed on the JS thread.
+  std::shared_ptr<jsi::Value> share(jsi::Runtime& runtime, const JsInvoker& invoker, const jsi::Value& value);
+
+  // Calls `callback` (a shared JS function, or undefined) on the JS thread with the arguments produced by `args`.
+  void callLater(jsi::Runtime& runtime, const JsInvoker& invoker, const std::shared_ptr<jsi::Value>& callback,
+                 std::function<std::vector<jsi::Value>(jsi::Runtime&)> args);
+
+  // Runs `task` on the worker pool, which has one thread per core.
+  void run(std::function<void()> task);
+
+  // Calls `fn` with each of 0..n-1, spread across the worker pool and the calling thread, and returns once all calls
+  // returned. Safe to call from the worker pool: the calling thread works through the indexes that no worker picked
+  // up, so it never waits on a busy pool. `fn` must not throw.
+  void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+}
+
+#endif /* async_h */
@@ -0,0 +1,410 @@
+#include "blob.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Blob {
+
+namespace {
+
+const char kHeader[2] = {(char)0xc1, 0x02};
+const size_t kPointerSize = sizeof(kHeader) + 8 + 8 + 4;
+const size_t kRecordHeaderSize = 4 + 4;
+const char kSuffix[] = ".blob";
+// Past this size, appends go to a new file, so that garbage collection reclaims space in reasonably small steps.
+const uint64_t kMaxFileBytes = 64 * 1024 * 1024;
+
+leveldb::Status ioError(const std::string& context) {
+  return leveldb::Status::IOError(context, strerror(errno));
+}
+
+void putFixed(std::string* dst, uint64_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    dst->push_back((char)(value >> (8 * i)));
+  }
+}
+
+uint64_t getFixed(const char* src, int bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value = (value << 8) | (uint8_t)src[i];
+  }
+  return value;
+}
+
+std::string encodePointer(uint64_t file, uint64_t offset, uint32_t size) {
+  std::string pointer(kHeader, sizeof(kHeader));
+  putFixed(&pointer, file, 8);
+  putFixed(&pointer, offset, 8);
+  putFixed(&pointer, size, 4);
+  return pointer;
+}
+
+void decodePointer(const leveldb::Slice& pointer, uint64_t* file, uint64_t* offset, uint32_t* size) {
+  const char* p = pointer.data() + sizeof(kHeader);
+  *file = getFixed(p, 8);
+  *offset = getFixed(p + 8, 8);
+  *size = (uint32_t)getFixed(p + 16, 4);
+}
+
+std::string filePath(const std::string& dir, uint64_t file) {
+  char name[32];
+  snprintf(name, sizeof(name), "/%06" PRIu64 "%s", file, kSuffix);
+  return dir + name;
+}
+
+// Returns false if `name` isn't the name of a blob file.
+bool parseFileName(const std::string& name, uint64_t* file) {
+  size_t suffixSize = sizeof(kSuffix) - 1;
+  if (name.size() <= suffixSize || name.compare(name.size() - suffixSize, suffixSize, kSuffix) != 0) {
+    return false;
+  }
+  std::string digits = name.substr(0, name.size() - suffixSize);
+  if (digits.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  *file = strtoull(digits.c_str(), nullptr, 10);
+  return true;
+}
+
+leveldb::Status listFiles(const std::string& dir, std::vector<uint64_t>* files) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    return ioError(dir);
+  }
+  while (struct dirent* entry = readdir(d)) {
+    uint64_t file;
+    if (parseFileName(entry->d_name, &file)) {
+      files->push_back(file);
+    }
+  }
+  closedir(d);
+  return leveldb::Status::OK();
+}
+
+// Returns false if `fd` couldn't be synced, with errno set. Like LevelDB's env_posix: fdatasync() isn't in Apple's SDKs,
+// and fsync() doesn't get the data past the drive's cache there.
+bool syncFd(int fd) {
+#if defined(__APPLE__)
+  if (fcntl(fd, F_FULLFSYNC) == 0) {
+    return true;
+  }
+  // Not supported by every file system.
+  return fsync(fd) == 0;
+#else
+  return fdatasync(fd) == 0;
+#endif
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, data, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+bool readAll(int fd, char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    // pread() doesn't move a shared file position, so concurrent reads of a file can share its descriptor.
+    ssize_t n = pread(fd, data, size, (off_t)offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      if (n == 0) {
+        errno = EIO;
+      }
+      return false;
+    }
+    data += n;
+    size -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+  return true;
+}
+
+class ResolvingIterator : public leveldb::Iterator {
+ public:
+  ResolvingIterator(leveldb::Iterator* iterator, std::shared_ptr<Store> store)
+      : store_(std::move(store)), iterator_(iterator) {}
+
+  bool Valid() const override {
+    return iterator_->Valid();
+  }
+  void SeekToFirst() override {
+    resolved_ = false;
+    iterator_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    resolved_ = false;
+    iterator_->SeekToLast();
+  }
+  void Seek(const leveldb::Slice& target) override {
+    resolved_ = false;
+    iterator_->Seek(target);
+  }
+  void Next() override {
+    resolved_ = false;
+    iterator_->Next();
+  }
+  void Prev() override {
+    resolved_ = false;
+    iterator_->Prev();
+  }
+  leveldb::Slice key() const override {
+    return iterator_->key();
+  }
+  // Resolved on first use, so that scans that skip values (e.g. on their keys) don't read them.
+  leveldb::Slice value() const override {
+    leveldb::Slice value = iterator_->value();
+    if (!isPointer(value)) {
+      return value;
+    }
+    if (!resolved_) {
+      resolved_ = true;
+      leveldb::Status status = store_->resolve(value, &value_);
+      if (!status.ok()) {
+        value_.clear();
+        if (status_.ok()) {
+          status_ = status;
+        }
+      }
+    }
+    return value_;
+  }
+  leveldb::Status status() const override {
+    return status_.ok() ? iterator_->status() : status_;
+  }
+
+ private:
+  const std::shared_ptr<Store> store_;
+  const std::unique_ptr<leveldb::Iterator> iterator_;
+  mutable bool resolved_ = false;
+  mutable std::string value_;
+  // The first error resolving a value, if any.
+  mutable leveldb::Status status_;
+};
+
+}  // namespace
+
+bool isPointer(const leveldb::Slice& value) {
+  return value.size() == kPointerSize && value[0] == kHeader[0] && value[1] == kHeader[1];
+}
+
+void pointee(const leveldb::Slice& pointer, uint64_t* file, uint64_t* size) {
+  uint64_t offset;
+  uint32_t valueSize;
+  decodePointer(pointer, file, &offset, &valueSize);
+  *size = valueSize;
+}
+
+leveldb::Status Store::open(const std::string& dir, size_t threshold, std::shared_ptr<Store>* store) {
+  std::vector<uint64_t> files;
+  leveldb::Status status = listFiles(dir, &files);
+  if (!status.ok()) {
+    return status;
+  }
+  std::shared_ptr<Store> opened(new Store(dir, threshold));
+  for (uint64_t file : files) {
+    opened->files_.insert(file);
+    opened->nextFile_ = std::max(opened->nextFile_, file + 1);
+  }
+  opened->hasFiles_ = !files.empty();
+  *store = std::move(opened);
+  return status;
+}
+
+Store::~Store() {
+  if (appendFd_ >= 0) {
+    close(appendFd_);
+  }
+  removeRetired();
+  for (auto& fd : readFds_) {
+    close(fd.second);
+  }
+}
+
+leveldb::Status Store::append(const leveldb::Slice& key, const leveldb::Slice& value, std::string* pointer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (appendFd_ >= 0 && appendSize_ >= kMaxFileBytes) {
+    // Synced first, sync() only syncs the current file. On failure, the file is kept, and synced by the next try.
+    if (!syncFd(appendFd_)) {
+      return ioError(filePath(dir_, appendFile_));
+    }
+    close(appendFd_);
+    appendFd_ = -1;
+  }
+  if (appendFd_ < 0) {
+    uint64_t file = nextFile_++;
+    std::string path = filePath(dir_, file);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND, 0644);
+    if (fd < 0) {
+      return ioError(path);
+    }
+    // So that the file's directory entry is as durable as the values synced to it.
+    int dirFd = ::open(dir_.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+      fsync(dirFd);
+      close(dirFd);
+    }
+    appendFd_ = fd;
+    appendFile_ = file;
+    appendSize_ = 0;
+    files_.insert(file);
+    hasFiles_ = true;
+  }
+
+  // The value is written from where it is: it may be megabytes.
+  std::string prefix;
+  putFixed(&prefix, key.size(), 4);
+  putFixed(&prefix, value.size(), 4);
+  prefix.append(key.data(), key.size());
+  if (!writeAll(appendFd_, prefix.data(), prefix.size()) || !writeAll(appendFd_, value.data(), value.size())) {
+    leveldb::Status status = ioError(filePath(dir_, appendFile_));
+    close(appendFd_);
+    appendFd_ = -1;
+    return status;
+  }
+  *pointer = encodePointer(appendFile_, appendSize_ + prefix.size(), (uint32_t)value.size());
+  appendSize_ += prefix.size() + value.size();
+  return leveldb::Status::OK();
+}
+
+leveldb::Status Store::sync() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (appendFd_ >= 0 && !syncFd(appendFd_)) {
+    return ioError(filePath(dir_, appendFile_));
+  }
+  return leveldb::Status::OK();
+}
+
+int Store::readFd(uint64_t file) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = readFds_.find(file);
+  if (it != readFds_.end()) {
+    return it->second;
+  }
+  int fd = ::open(filePath(dir_, file).c_str(), O_RDONLY);
+  if (fd >= 0) {
+    readFds_[file] = fd;
+  }
+  return fd;
+}
+
+leveldb::Status Store::resolve(const leveldb::Slice& pointer, std::string* value) {
+  uint64_t file, offset;
+  uint32_t size;
+  decodePointer(pointer, &file, &offset, &size);
+  int fd = readFd(file);
+  if (fd < 0) {
+    return ioError(filePath(dir_, file));
+  }
+  value->resize(size);
+  if (!readAll(fd, &(*value)[0], size, offset)) {
+    return ioError(filePath(dir_, file));
+  }
+  return leveldb::Status::OK();
+}
+
+leveldb::Status Store::seal(std::vector<uint64_t>* files) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (appendFd_ >= 0) {
+    if (!syncFd(appendFd_)) {
+      return ioError(filePath(dir_, appendFile_));
+    }
+    close(appendFd_);
+    appendFd_ = -1;
+  }
+  for (uint64_t file : files_) {
+    if (retired_.count(file) == 0) {
+      files->push_back(file);
+    }
+  }
+  return leveldb::Status::OK();
+}
+
+uint64_t Store::fileSize(uint64_t file) {
+  struct stat st;
+  return stat(filePath(dir_, file).c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+leveldb::Status Store::forEachRecord(uint64_t file,
+                                     const std::function<void(const leveldb::Slice&, const std::string&)>& fn) {
+  int fd = readFd(file);
+  if (fd < 0) {
+    return ioError(filePath(dir_, file));
+  }
+  uint64_t size = fileSize(file);
+  std::string key;
+  char header[kRecordHeaderSize];
+  // A torn record at the end, from an append that failed, was never pointed to.
+  for (uint64_t offset = 0; size - offset >= kRecordHeaderSize;) {
+    if (!readAll(fd, header, sizeof(header), offset)) {
+      return ioError(filePath(dir_, file));
+    }
+    uint64_t keySize = getFixed(header, 4), valueSize = getFixed(header + 4, 4);
+    if (size - offset - kRecordHeaderSize < keySize + valueSize) {
+      break;
+    }
+    key.resize(keySize);
+    if (!readAll(fd, &key[0], keySize, offset + kRecordHeaderSize)) {
+      return ioError(filePath(dir_, file));
+    }
+    fn(key, encodePointer(file, offset + kRecordHeaderSize + keySize, (uint32_t)valueSize));
+    offset += kRecordHeaderSize + keySize + valueSize;
+  }
+  return leveldb::Status::OK();
+}
+
+void Store::retire(uint64_t file) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_.insert(file);
+}
+
+void Store::removeRetired() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (uint64_t file : retired_) {
+    auto fd = readFds_.find(file);
+    if (fd != readFds_.end()) {
+      close(fd->second);
+      readFds_.erase(fd);
+    }
+    unlink(filePath(dir_, file).c_str());
+    files_.erase(file);
+  }
+  retired_.clear();
+}
+
+leveldb::Iterator* newResolvingIterator(leveldb::Iterator* iterator, std::shared_ptr<Store> store) {
+  return new ResolvingIterator(iterator, std::move(store));
+}
+
+void destroy(const std::string& dir) {
+  std::vector<uint64_t> files;
+  if (!listFiles(dir, &files).ok() || files.empty()) {
+    return;
+  }
+  for (uint64_t file : files) {
+    unlink(filePath(dir, file).c_str());
+  }
+  // Fails if LevelDB's own files are still there, e.g. if the DB is open.
+  rmdir(dir.c_str());
+}
+
+}  // namespace Blob
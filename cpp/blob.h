@@ -0,0 +1,102 @@
+#ifndef blob_h
+#define blob_h
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <leveldb/iterator.h>
+#include <leveldb/slice.h>
+#include <leveldb/status.h>
+
+// Blob separation: large values are appended to blob files in the DB's directory, and LevelDB only holds pointers to
+// them, so that compactions don't rewrite them over and over. A pointer is 0xc1 0x02, then the number of the blob file
+// as a big-endian fixed64, the offset of the value in it as a fixed64, and its size as a fixed32. Like TTL headers
+// (see Ttl), 0xc1 can't start a msgpack value.
+//
+// Blob files are named <number>.blob, which LevelDB leaves alone. They hold records: the key and value sizes as
+// big-endian fixed32s, then the key and the value. The key is what garbage collection looks the value up by. A file is
+// only ever appended to by the Store that created it: each open starts a new one, which is what lets checkpoints
+// hard-link them.
+namespace Blob {
+  bool isPointer(const leveldb::Slice& value);
+  // The blob file that `pointer` points into, and the size of the value it points to.
+  void pointee(const leveldb::Slice& pointer, uint64_t* file, uint64_t* size);
+
+  // The blob files of an open DB.
+  class Store {
+   public:
+    // Values of `threshold` bytes or more are separated, none with 0.
+    static leveldb::Status open(const std::string& dir, size_t threshold, std::shared_ptr<Store>* store);
+    // Removes the retired files.
+    ~Store();
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    // Whether writing `value` stores it in a blob file. Values that look like pointers are too, whatever the threshold,
+    // so that they aren't mistaken for one when read back, now or once the DB has blob files.
+    bool separates(const leveldb::Slice& value) const {
+      return isPointer(value) || (threshold_ > 0 && value.size() >= threshold_);
+    }
+    // Whether stored values may be pointers. They can't be in a DB that never had blob files, whose values are then
+    // read as they are, whatever they look like.
+    bool resolves() const {
+      return hasFiles_.load();
+    }
+
+    // Appends `value`, and sets `*pointer` to point to it. Not synced, see sync().
+    leveldb::Status append(const leveldb::Slice& key, const leveldb::Slice& value, std::string* pointer);
+    // Syncs what was appended so far. Called before committing the pointers with a sync write.
+    leveldb::Status sync();
+    // Reads the value that `pointer` points to.
+    leveldb::Status resolve(const leveldb::Slice& pointer, std::string* value);
+
+    // For garbage collection: starts a new file for the next appends, and sets `*files` to the others, which are then
+    // only read from, except those already retired.
+    leveldb::Status seal(std::vector<uint64_t>* files);
+    uint64_t fileSize(uint64_t file);
+    // Calls `fn` with the key of each record in `file` and a pointer to its value.
+    leveldb::Status forEachRecord(uint64_t file,
+                                  const std::function<void(const leveldb::Slice&, const std::string&)>& fn);
+    // Marks `file` as unused. It's removed by removeRetired(), or once the store is destroyed, which the caller makes
+    // sure happens only once nothing can read it anymore.
+    void retire(uint64_t file);
+    void removeRetired();
+
+   private:
+    Store(std::string dir, size_t threshold) : dir_(std::move(dir)), threshold_(threshold) {}
+
+    // Returns -1 if `file` can't be opened, with errno set.
+    int readFd(uint64_t file);
+
+    const std::string dir_;
+    const size_t threshold_;
+    std::atomic<bool> hasFiles_{false};
+
+    // Guards the files and the file being appended to.
+    std::mutex mutex_;
+    std::unordered_set<uint64_t> files_;
+    std::unordered_set<uint64_t> retired_;
+    uint64_t nextFile_ = 1;
+    // -1 until the first append, and after a failed one, which leaves the file with a torn record.
+    int appendFd_ = -1;
+    uint64_t appendFile_ = 0;
+    uint64_t appendSize_ = 0;
+    // Opened on first read, kept open until the file is removed.
+    std::unordered_map<uint64_t, int> readFds_;
+  };
+
+  // Wraps `iterator`, an iterator over the stored values of a DB, so that its values are the ones pointed to. A value
+  // that can't be read is empty, and fails status().
+  leveldb::Iterator* newResolvingIterator(leveldb::Iterator* iterator, std::shared_ptr<Store> store);
+
+  // Removes the blob files in `dir`, which LevelDB's DestroyDB() leaves behind, then `dir` if it's empty.
+  void destroy(const std::string& dir);
+}
+
+#endif /* blob_h */
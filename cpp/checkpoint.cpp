@@ -0,0 +1,209 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Checkpoint {
+
+namespace {
+
+struct FileCloser {
+  void operator()(FILE* file) const {
+    fclose(file);
+  }
+};
+using File = std::unique_ptr<FILE, FileCloser>;
+
+const char kTempSuffix[] = ".readonly-";
+const char kBlobSuffix[] = ".blob";
+
+leveldb::Status ioError(const std::string& context) {
+  return leveldb::Status::IOError(context, strerror(errno));
+}
+
+bool endsWith(const std::string& s, const char* suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+leveldb::Status listDir(const std::string& dir, std::vector<std::string>* names) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    return ioError(dir);
+  }
+  while (struct dirent* entry = readdir(d)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") {
+      names->push_back(std::move(name));
+    }
+  }
+  closedir(d);
+  return leveldb::Status::OK();
+}
+
+// Copies what `src` holds now. Files that are appended to while they're copied end up with a prefix of what was
+// appended, which LevelDB reads as a writer that stopped there. With `skipMissing`, a missing `src` is skipped: tables
+// and logs that LevelDB deleted since the directory was listed are obsolete.
+leveldb::Status copyFile(const std::string& src, const std::string& dest, bool skipMissing = false) {
+  File in(fopen(src.c_str(), "rb"));
+  if (!in) {
+    return skipMissing && errno == ENOENT ? leveldb::Status::OK() : ioError(src);
+  }
+  File out(fopen(dest.c_str(), "wb"));
+  if (!out) {
+    return ioError(dest);
+  }
+  char buf[64 * 1024];
+  size_t read;
+  while ((read = fread(buf, 1, sizeof(buf), in.get())) > 0) {
+    if (fwrite(buf, 1, read, out.get()) != read) {
+      return ioError(dest);
+    }
+  }
+  if (ferror(in.get())) {
+    return ioError(src);
+  }
+  if (fflush(out.get()) != 0 || fsync(fileno(out.get())) != 0 || fclose(out.release()) != 0) {
+    return ioError(dest);
+  }
+  return leveldb::Status::OK();
+}
+
+// Skips a missing `src`, like copyFile() with `skipMissing`.
+leveldb::Status linkOrCopyFile(const std::string& src, const std::string& dest) {
+  if (link(src.c_str(), dest.c_str()) == 0 || errno == ENOENT) {
+    return leveldb::Status::OK();
+  }
+  // E.g. EXDEV across file systems, or EPERM where hard links aren't allowed.
+  return copyFile(src, dest, true);
+}
+
+leveldb::Status readCurrent(const std::string& dir, std::string* manifest) {
+  File file(fopen((dir + "/CURRENT").c_str(), "rb"));
+  if (!file) {
+    return ioError(dir + "/CURRENT");
+  }
+  char buf[256];
+  size_t size = fread(buf, 1, sizeof(buf), file.get());
+  manifest->assign(buf, size);
+  if (manifest->empty() || manifest->back() != '\n') {
+    return leveldb::Status::Corruption(dir + "/CURRENT", "not newline-terminated");
+  }
+  manifest->pop_back();
+  return leveldb::Status::OK();
+}
+
+leveldb::Status writeCurrent(const std::string& dir, const std::string& manifest) {
+  std::string path = dir + "/CURRENT";
+  File file(fopen(path.c_str(), "wb"));
+  std::string contents = manifest + "\n";
+  if (!file || fwrite(contents.data(), 1, contents.size(), file.get()) != contents.size() ||
+      fflush(file.get()) != 0 || fsync(fileno(file.get())) != 0 || fclose(file.release()) != 0) {
+    return ioError(path);
+  }
+  return leveldb::Status::OK();
+}
+
+}  // namespace
+
+leveldb::Status create(const std::string& src, const std::string& dest) {
+  std::string manifest;
+  leveldb::Status status = readCurrent(src, &manifest);
+  if (!status.ok()) {
+    return status;
+  }
+  std::vector<std::string> names;
+  status = listDir(src, &names);
+  if (!status.ok()) {
+    return status;
+  }
+  if (mkdir(dest.c_str(), 0755) != 0) {
+    return ioError(dest);
+  }
+
+  // Blob files (see Blob) first, which the tables and logs point into, then tables, then logs, then the MANIFEST: the
+  // copied MANIFEST then lists no table flushed from a log that isn't in the checkpoint, unless the table was written
+  // after the tables were linked, which makes the open fail.
+  for (const std::string& name : names) {
+    if (status.ok() && endsWith(name, kBlobSuffix)) {
+      status = linkOrCopyFile(src + "/" + name, dest + "/" + name);
+    }
+  }
+  for (const std::string& name : names) {
+    if (status.ok() && (endsWith(name, ".ldb") || endsWith(name, ".sst"))) {
+      status = linkOrCopyFile(src + "/" + name, dest + "/" + name);
+    }
+  }
+  for (const std::string& name : names) {
+    if (status.ok() && endsWith(name, ".log")) {
+      status = copyFile(src + "/" + name, dest + "/" + name, true);
+    }
+  }
+  if (status.ok()) {
+    status = copyFile(src + "/" + manifest, dest + "/" + manifest);
+  }
+  if (status.ok()) {
+    // Blob files started meanwhile, which the copied logs may point into. Those linked already fail with EEXIST.
+    std::vector<std::string> newNames;
+    status = listDir(src, &newNames);
+    for (const std::string& name : newNames) {
+      if (status.ok() && endsWith(name, kBlobSuffix) && std::find(names.begin(), names.end(), name) == names.end()) {
+        status = linkOrCopyFile(src + "/" + name, dest + "/" + name);
+      }
+    }
+  }
+  if (status.ok()) {
+    // Written last, a directory without CURRENT isn't a DB. Not copied: it must name the MANIFEST that was copied,
+    // even if LevelDB has switched to another one since.
+    status = writeCurrent(dest, manifest);
+  }
+
+  if (!status.ok()) {
+    removeDir(dest);
+  }
+  return status;
+}
+
+void removeDir(const std::string& dir) {
+  std::vector<std::string> names;
+  listDir(dir, &names);
+  for (const std::string& name : names) {
+    unlink((dir + "/" + name).c_str());
+  }
+  rmdir(dir.c_str());
+}
+
+std::string newTempPath(const std::string& dbPath) {
+  static std::atomic<int> next{0};
+  return dbPath + kTempSuffix + std::to_string(getpid()) + "-" + std::to_string(next++);
+}
+
+void removeStaleTempPaths(const std::string& dbPath) {
+  size_t slash = dbPath.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : dbPath.substr(0, slash);
+  std::string prefix = dbPath.substr(slash == std::string::npos ? 0 : slash + 1) + kTempSuffix;
+  std::vector<std::string> names;
+  listDir(dir, &names);
+  for (const std::string& name : names) {
+    if (name.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    pid_t pid = (pid_t)strtol(name.c_str() + prefix.size(), nullptr, 10);
+    // kill() with no signal only checks that the process exists. EPERM means it does, but isn't ours to signal.
+    if (pid > 0 && pid != getpid() && kill(pid, 0) != 0 && errno == ESRCH) {
+      removeDir(dir + "/" + name);
+    }
+  }
+}
+
+}  // namespace Checkpoint
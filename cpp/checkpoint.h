@@ -0,0 +1,43 @@
+#ifndef checkpoint_h
+#define checkpoint_h
+
+#include <string>
+#include <leveldb/status.h>
+
+// Checkpoints: directories that open as a DB of their own, holding what another DB held when they were made, without
+// needing that DB's lock. Table files never change once written, so they're hard-linked (copied where links aren't
+// supported), which takes no extra space and keeps them around if LevelDB deletes them from the source. So are blob
+// files (see Blob), which are only appended to by the DB that started them. The files that LevelDB appends to
+// (CURRENT, the MANIFEST it names, and the logs) are copied.
+//
+// LevelDB may change the source while it's copied: a table that the copied MANIFEST lists may have been written after
+// the tables were linked. LevelDB refuses to open a DB that misses files, so a checkpoint that opens is consistent, as
+// of some point while it was made. Callers retry if it doesn't.
+namespace Checkpoint {
+  // Makes `dest`, which must not exist, a checkpoint of the DB in `src`. `dest` is removed if this fails.
+  leveldb::Status create(const std::string& src, const std::string& dest);
+
+  // Removes `dir` and the files in it. Checkpoints have no subdirectories.
+  void removeDir(const std::string& dir);
+
+  // A new path for a checkpoint of the DB at `dbPath` that this process removes once done with it, next to the DB.
+  std::string newTempPath(const std::string& dbPath);
+  // Removes the checkpoints of `dbPath` left behind by processes that exited without removing theirs, e.g. crashed.
+  void removeStaleTempPaths(const std::string& dbPath);
+
+  // A directory removed when the last reference to it goes away, e.g. a checkpoint that a DB was opened from, once
+  // the DB closes.
+  class TempDir {
+   public:
+    explicit TempDir(std::string path) : path(std::move(path)) {}
+    ~TempDir() {
+      removeDir(path);
+    }
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    const std::string path;
+  };
+}
+
+#endif /* checkpoint_h */
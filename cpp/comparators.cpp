@@ -0,0 +1,73 @@
+#include "comparators.h"
+
+#include <cstdint>
+
+namespace Comparators {
+
+namespace {
+
+// Leaves keys as they are in FindShortestSeparator() and FindShortSuccessor(). Shortening index keys is only an
+// optimization, and doing it right for these orders isn't worth the complexity.
+class UnshortenedComparator : public leveldb::Comparator {
+ public:
+  void FindShortestSeparator(std::string* start, const leveldb::Slice& limit) const override {}
+  void FindShortSuccessor(std::string* key) const override {}
+};
+
+class ReverseComparator : public UnshortenedComparator {
+ public:
+  const char* Name() const override {
+    return "rnleveldb.ReverseBytewiseComparator";
+  }
+
+  int Compare(const leveldb::Slice& a, const leveldb::Slice& b) const override {
+    return b.compare(a);
+  }
+};
+
+class Int64Comparator : public UnshortenedComparator {
+ public:
+  const char* Name() const override {
+    return "rnleveldb.Int64Comparator";
+  }
+
+  int Compare(const leveldb::Slice& a, const leveldb::Slice& b) const override {
+    // Short keys first, so that the order stays total.
+    bool aShort = a.size() < 8, bShort = b.size() < 8;
+    if (aShort || bShort) {
+      return aShort && bShort ? a.compare(b) : aShort ? -1 : 1;
+    }
+    int64_t x = decode(a.data()), y = decode(b.data());
+    if (x != y) {
+      return x < y ? -1 : 1;
+    }
+    return leveldb::Slice(a.data() + 8, a.size() - 8).compare(leveldb::Slice(b.data() + 8, b.size() - 8));
+  }
+
+ private:
+  static int64_t decode(const char* data) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+      value = (value << 8) | (uint8_t)data[i];
+    }
+    return (int64_t)value;
+  }
+};
+
+}  // namespace
+
+const leveldb::Comparator* named(const std::string& name) {
+  // Never destroyed: DBs may still use them during static destruction.
+  static const ReverseComparator* reverse = new ReverseComparator();
+  static const Int64Comparator* int64 = new Int64Comparator();
+  if (name == "bytewise") {
+    return leveldb::BytewiseComparator();
+  } else if (name == "reverse") {
+    return reverse;
+  } else if (name == "int64") {
+    return int64;
+  }
+  return nullptr;
+}
+
+}  // namespace Comparators
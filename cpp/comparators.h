@@ -0,0 +1,20 @@
+#ifndef comparators_h
+#define comparators_h
+
+#include <string>
+#include <leveldb/comparator.h>
+
+// The key orders that a DB can be opened with. LevelDB records the comparator's name in the DB, and refuses to open
+// it with another one later.
+//
+// - "bytewise": LevelDB's default, lexicographic order of the raw bytes.
+// - "reverse": bytewise, reversed. Newest-first scans over increasing keys (e.g. timestamps) then go forwards.
+// - "int64": keys start with a 64-bit big-endian two's complement integer (e.g. written with DataView.setBigInt64()),
+//   and sort by its value, negative numbers included, then by the rest of the key, bytewise. Keys shorter than 8
+//   bytes sort before all others.
+namespace Comparators {
+  // Returns nullptr if `name` isn't one of the above. The comparators live as long as the process.
+  const leveldb::Comparator* named(const std::string& name);
+}
+
+#endif /* comparators_h */
@@ -0,0 +1,648 @@
+#include "db-handle.h"
+
+#include <algorithm>
+
+// Mirrors the writes of a batch into the pending values, so that get() can serve them before they're committed.
+class DbHandle::PendingValuesUpdater : public leveldb::WriteBatch::Handler {
+ public:
+  explicit PendingValuesUpdater(std::unordered_map<std::string, PendingValue>* values) : values_(values) {}
+
+  void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+    (*values_)[key.ToString()] = PendingValue{false, value.ToString()};
+  }
+
+  void Delete(const leveldb::Slice& key) override {
+    (*values_)[key.ToString()] = PendingValue{true, std::string()};
+  }
+
+ private:
+  std::unordered_map<std::string, PendingValue>* values_;
+};
+
+// Finds out whether a batch has values that go to blob files, without copying it.
+class DbHandle::BlobFinder : public leveldb::WriteBatch::Handler {
+ public:
+  explicit BlobFinder(const Blob::Store* blobs) : blobs_(blobs) {}
+
+  void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+    found = found || blobs_->separates(value);
+  }
+
+  void Delete(const leveldb::Slice& key) override {}
+
+  bool found = false;
+
+ private:
+  const Blob::Store* blobs_;
+};
+
+// Rewrites a batch, with the values that go to blob files replaced by pointers to them.
+class DbHandle::BlobSeparator : public leveldb::WriteBatch::Handler {
+ public:
+  explicit BlobSeparator(Blob::Store* blobs) : blobs_(blobs) {}
+
+  void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+    if (!status.ok() || !blobs_->separates(value)) {
+      batch.Put(key, value);
+      return;
+    }
+    std::string pointer;
+    status = blobs_->append(key, value, &pointer);
+    batch.Put(key, pointer);
+    separated++;
+  }
+
+  void Delete(const leveldb::Slice& key) override {
+    batch.Delete(key);
+  }
+
+  leveldb::WriteBatch batch;
+  size_t separated = 0;
+  leveldb::Status status;
+
+ private:
+  Blob::Store* blobs_;
+};
+
+namespace {
+
+// The bulk load profile's memtable size, and the size of the tables it writes. LevelDB's defaults are 4MB and 2MB.
+const size_t kBulkLoadWriteBufferSize = 64 * 1024 * 1024;
+const size_t kBulkLoadMaxFileSize = 32 * 1024 * 1024;
+
+// How many checkpoints openCheckpoint() makes before giving up, when the DB keeps changing while they're made.
+const int kCheckpointAttempts = 3;
+
+// The bytes of values that collectBlobGarbage() moves with writes held off, before letting them through.
+const size_t kBlobGcChunkBytes = 4 * 1024 * 1024;
+
+leveldb::Status reopenFailed(const std::string& path) {
+  return leveldb::Status::IOError(path, "closed, reopening it failed");
+}
+
+leveldb::Status readOnlyError(const std::string& path) {
+  return leveldb::Status::NotSupported(path, "opened read-only");
+}
+
+void releaseDb(void* db, void*) {
+  delete (std::shared_ptr<leveldb::DB>*)db;
+}
+
+}  // namespace
+
+leveldb::Status DbHandle::open(std::string path, const leveldb::Options& options,
+                               std::shared_ptr<const leveldb::FilterPolicy> filterPolicy, DbProfile profile,
+                               size_t blobThreshold, std::shared_ptr<DbHandle>* handle) {
+  std::shared_ptr<DbHandle> opened(new DbHandle(std::move(path), options, std::move(filterPolicy)));
+  leveldb::Status status = opened->openLocked(profile, options.create_if_missing, options.error_if_exists);
+  if (status.ok()) {
+    // Once LevelDB has created the directory, if it had to.
+    status = Blob::Store::open(opened->path, blobThreshold, &opened->blobs_);
+  }
+  if (status.ok()) {
+    *handle = std::move(opened);
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::openCheckpoint(const std::string& source, std::string path, const leveldb::Options& options,
+                                         std::shared_ptr<const leveldb::FilterPolicy> filterPolicy, DbProfile profile,
+                                         std::shared_ptr<DbHandle>* handle) {
+  leveldb::Status status;
+  for (int attempt = 0; attempt < kCheckpointAttempts; attempt++) {
+    status = Checkpoint::create(source, path);
+    if (!status.ok()) {
+      continue;
+    }
+    // Removes the checkpoint as it goes away, if it doesn't open.
+    std::shared_ptr<DbHandle> opened(new DbHandle(path, options, filterPolicy));
+    opened->checkpointDir_ = std::make_shared<const Checkpoint::TempDir>(path);
+    status = opened->openLocked(profile);
+    if (status.ok()) {
+      status = Blob::Store::open(path, 0, &opened->blobs_);
+    }
+    if (status.ok()) {
+      *handle = std::move(opened);
+      return status;
+    }
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::openLocked(DbProfile profile, bool createIfMissing, bool errorIfExists) {
+  leveldb::Options options = options_;
+  options.create_if_missing = createIfMissing;
+  options.error_if_exists = errorIfExists;
+  if (profile == DbProfile::kBulkLoad) {
+    options.write_buffer_size = std::max(options.write_buffer_size, kBulkLoadWriteBufferSize);
+    options.max_file_size = std::max(options.max_file_size, kBulkLoadMaxFileSize);
+  }
+  leveldb::DB* db;
+  leveldb::Status status = leveldb::DB::Open(options, path, &db);
+  if (!status.ok()) {
+    return status;
+  }
+  std::shared_ptr<const leveldb::FilterPolicy> filterPolicy = filterPolicy_;
+  std::shared_ptr<const Checkpoint::TempDir> checkpointDir = checkpointDir_;
+  db_.reset(db, [filterPolicy, checkpointDir](leveldb::DB* db) { delete db; });
+  profile_ = profile;
+  return status;
+}
+
+DbHandle::~DbHandle() {
+  {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    stopFlusher_ = true;
+  }
+  flusherCv_.notify_all();
+  if (flusher_.joinable()) {
+    flusher_.join();
+  }
+
+  std::lock_guard<std::mutex> lock(pendingMutex_);
+  flushLocked(syncByDefault.load());
+}
+
+leveldb::WriteOptions DbHandle::writeOptions() const {
+  leveldb::WriteOptions options;
+  options.sync = syncByDefault.load();
+  return options;
+}
+
+leveldb::Status DbHandle::put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value) {
+  if (readOnly()) {
+    return readOnlyError(path);
+  }
+  std::shared_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+  std::string pointer;
+  leveldb::Slice stored = value;
+  if (blobs_->separates(value)) {
+    leveldb::Status status = blobs_->append(key, value, &pointer);
+    if (status.ok() && options.sync) {
+      status = blobs_->sync();
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    stored = pointer;
+  }
+  if (maxPendingBytes_.load() == 0) {
+    leveldb::Status status;
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+      status = db_ ? db_->Put(options, key, stored) : reopenFailed(path);
+    }
+    if (status.ok()) {
+      watchers.publish(key);
+    }
+    return status;
+  }
+  leveldb::WriteBatch batch;
+  batch.Put(key, stored);
+  return writeLocked(options, &batch);
+}
+
+leveldb::Status DbHandle::del(const leveldb::WriteOptions& options, const leveldb::Slice& key) {
+  if (readOnly()) {
+    return readOnlyError(path);
+  }
+  std::shared_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+  if (maxPendingBytes_.load() == 0) {
+    leveldb::Status status;
+    {
+      std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+      status = db_ ? db_->Delete(options, key) : reopenFailed(path);
+    }
+    if (status.ok()) {
+      watchers.publish(key);
+    }
+    return status;
+  }
+  leveldb::WriteBatch batch;
+  batch.Delete(key);
+  return writeLocked(options, &batch);
+}
+
+leveldb::Status DbHandle::write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) {
+  if (readOnly()) {
+    return readOnlyError(path);
+  }
+  std::shared_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+  leveldb::Status status = separateBlobs(options, batch);
+  if (!status.ok()) {
+    return status;
+  }
+  return writeLocked(options, batch);
+}
+
+leveldb::Status DbHandle::update(const leveldb::WriteOptions& options,
+                                 const std::function<leveldb::Status(leveldb::WriteBatch*)>& fill) {
+  if (readOnly()) {
+    return readOnlyError(path);
+  }
+  std::unique_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+  leveldb::WriteBatch batch;
+  leveldb::Status status = fill(&batch);
+  if (status.ok()) {
+    status = separateBlobs(options, &batch);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return writeLocked(options, &batch);
+}
+
+leveldb::Status DbHandle::separateBlobs(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) {
+  // Most batches have none, and are then written as they are.
+  BlobFinder finder(blobs_.get());
+  leveldb::Status status = batch->Iterate(&finder);
+  if (!status.ok() || !finder.found) {
+    return status;
+  }
+  BlobSeparator separator(blobs_.get());
+  status = batch->Iterate(&separator);
+  if (status.ok()) {
+    status = separator.status;
+  }
+  if (!status.ok() || separator.separated == 0) {
+    return status;
+  }
+  // The blobs must be as durable as the pointers to them.
+  if (options.sync) {
+    status = blobs_->sync();
+  }
+  if (status.ok()) {
+    *batch = std::move(separator.batch);
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::writeLocked(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch) {
+  // Can't change meanwhile: setCoalescing() waits for the write lock that the caller holds.
+  std::unique_lock<std::mutex> lock(pendingMutex_, std::defer_lock);
+  if (maxPendingBytes_.load() != 0) {
+    lock.lock();
+  }
+  if (maxPendingBytes_.load() == 0) {
+    leveldb::Status status;
+    {
+      std::shared_lock<std::shared_timed_mutex> dbLock(dbMutex_);
+      status = db_ ? db_->Write(options, batch) : reopenFailed(path);
+    }
+    if (status.ok()) {
+      watchers.publish(*batch);
+    }
+    return status;
+  }
+
+  if (!flusherStatus_.ok()) {
+    leveldb::Status status = flusherStatus_;
+    flusherStatus_ = leveldb::Status::OK();
+    return status;
+  }
+
+  if (pendingValues_.empty()) {
+    firstPendingWrite_ = std::chrono::steady_clock::now();
+    flusherCv_.notify_one();
+  }
+  pending_.Append(*batch);
+  PendingValuesUpdater updater(&pendingValues_);
+  batch->Iterate(&updater);
+
+  leveldb::Status status;
+  if (options.sync || pending_.ApproximateSize() >= maxPendingBytes_.load()) {
+    status = flushLocked(options.sync);
+  }
+  if (status.ok()) {
+    watchers.publish(*batch);
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value) {
+  warmupRecorder.recordKey(key);
+  std::shared_lock<std::shared_timed_mutex> dbLock(dbMutex_, std::defer_lock);
+  leveldb::Status status = getStored(options, key, value, &dbLock);
+  if (!status.ok() || !blobs_->resolves() || !Blob::isPointer(*value)) {
+    return status;
+  }
+  std::string pointer;
+  pointer.swap(*value);
+  return blobs_->resolve(pointer, value);
+}
+
+leveldb::Status DbHandle::getStored(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value,
+                                    std::shared_lock<std::shared_timed_mutex>* dbLock) {
+  if (maxPendingBytes_.load() != 0) {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    auto pending = pendingValues_.find(key.ToString());
+    if (pending != pendingValues_.end()) {
+      // Before the pending values are let go of: a blob that's no longer pointed to once they are may be removed.
+      dbLock->lock();
+      if (pending->second.deleted) {
+        return leveldb::Status::NotFound(key);
+      }
+      *value = pending->second.value;
+      return leveldb::Status::OK();
+    }
+  }
+  dbLock->lock();
+  return db_ ? db_->Get(options, key, value) : reopenFailed(path);
+}
+
+leveldb::Iterator* DbHandle::newIterator(const leveldb::ReadOptions& options) {
+  leveldb::Iterator* iterator = newStoredIterator(options);
+  return blobs_->resolves() ? Blob::newResolvingIterator(iterator, blobs_) : iterator;
+}
+
+leveldb::Iterator* DbHandle::newStoredIterator(const leveldb::ReadOptions& options) {
+  if (maxPendingBytes_.load() != 0) {
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    // An iterator without the staged writes would miss them, and so would the blob pointers that garbage collection
+    // looks for.
+    leveldb::Status status = flushLocked(syncByDefault.load());
+    if (!status.ok()) {
+      return leveldb::NewErrorIterator(status);
+    }
+  }
+  std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+  if (!db_) {
+    return leveldb::NewErrorIterator(reopenFailed(path));
+  }
+  leveldb::Iterator* iterator = db_->NewIterator(options);
+  // Run once the iterator is done with the DB, so that this can be what closes it.
+  iterator->RegisterCleanup(&releaseDb, new std::shared_ptr<leveldb::DB>(db_), nullptr);
+  return iterator;
+}
+
+uint64_t DbHandle::approximateSize(const leveldb::Range& range) {
+  std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+  uint64_t size = 0;
+  if (db_) {
+    db_->GetApproximateSizes(&range, 1, &size);
+  }
+  return size;
+}
+
+DbProfile DbHandle::profile() {
+  std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+  return profile_;
+}
+
+leveldb::Status DbHandle::setProfile(DbProfile profile, bool compact) {
+  {
+    std::lock_guard<std::mutex> pendingLock(pendingMutex_);
+    leveldb::Status status = flushLocked(syncByDefault.load());
+    if (!status.ok()) {
+      return status;
+    }
+    std::unique_lock<std::shared_timed_mutex> lock(dbMutex_);
+    // Also retries after a failed reopen.
+    if (!db_ || profile != profile_) {
+      if (db_.use_count() > 1) {
+        return leveldb::Status::InvalidArgument(path, "can't reopen the DB while iterators are open on it");
+      }
+      DbProfile previous = profile_;
+      db_.reset();
+      status = openLocked(profile);
+      if (!status.ok()) {
+        // Keep the DB usable if we can.
+        openLocked(previous);
+        return status;
+      }
+    }
+  }
+
+  if (compact) {
+    // Compacting doesn't need exclusive access: reads and writes can go on meanwhile.
+    std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+    if (db_) {
+      db_->CompactRange(nullptr, nullptr);
+    }
+  }
+  return leveldb::Status::OK();
+}
+
+leveldb::Status DbHandle::setCoalescing(size_t maxBytes, int maxDelayMs) {
+  // Exclusively, so that writes see the same setting from their first check of it until they're done.
+  std::unique_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+  std::lock_guard<std::mutex> lock(pendingMutex_);
+  maxPendingBytes_ = maxBytes;
+  maxPendingDelay_ = std::chrono::milliseconds(maxDelayMs);
+  if (maxBytes == 0) {
+    // The flusher stays parked until coalescing is turned back on.
+    return flushLocked(syncByDefault.load());
+  }
+
+  if (!flusher_.joinable()) {
+    flusher_ = std::thread(&DbHandle::runFlusher, this);
+  }
+  // Wake the flusher up, in case the delay was shortened.
+  flusherCv_.notify_one();
+  return leveldb::Status::OK();
+}
+
+leveldb::Status DbHandle::flush(bool sync) {
+  std::lock_guard<std::mutex> lock(pendingMutex_);
+  leveldb::Status status = flushLocked(sync);
+  if (status.ok() && !flusherStatus_.ok()) {
+    status = flusherStatus_;
+  }
+  flusherStatus_ = leveldb::Status::OK();
+  return status;
+}
+
+leveldb::Status DbHandle::flushLocked(bool sync) {
+  if (pendingValues_.empty()) {
+    return leveldb::Status::OK();
+  }
+  // On failure, the writes stay staged and are retried by the next flush.
+  leveldb::WriteOptions options;
+  options.sync = sync;
+  std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+  if (!db_) {
+    return reopenFailed(path);
+  }
+  leveldb::Status status = db_->Write(options, &pending_);
+  if (status.ok()) {
+    pending_.Clear();
+    pendingValues_.clear();
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::checkpoint(const std::string& dest) {
+  leveldb::Status status;
+  for (int attempt = 0; attempt < kCheckpointAttempts; attempt++) {
+    {
+      // Writes wait while the checkpoint is made, so that it holds exactly the writes made before the call, or before
+      // the retry. LevelDB's own flushes and compactions go on, which the retries cover.
+      std::unique_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+      std::lock_guard<std::mutex> pendingLock(pendingMutex_);
+      status = flushLocked(syncByDefault.load());
+      if (!status.ok()) {
+        return status;
+      }
+      // No reopen meanwhile.
+      std::shared_lock<std::shared_timed_mutex> lock(dbMutex_);
+      if (!db_) {
+        return reopenFailed(path);
+      }
+      status = Checkpoint::create(path, dest);
+    }
+    if (!status.ok()) {
+      continue;
+    }
+    // Checked with writes going on: opening it replays its log.
+    leveldb::Options options = options_;
+    options.create_if_missing = false;
+    options.error_if_exists = false;
+    leveldb::DB* db;
+    status = leveldb::DB::Open(options, dest, &db);
+    if (status.ok()) {
+      delete db;
+      return status;
+    }
+    Checkpoint::removeDir(dest);
+  }
+  return status;
+}
+
+leveldb::Status DbHandle::collectBlobGarbage(double minGarbageRatio, uint64_t* reclaimedBytes) {
+  *reclaimedBytes = 0;
+  if (readOnly()) {
+    return readOnlyError(path);
+  }
+  // New values go to a new file from now on: the values in the others can only die, except for those moved below.
+  std::vector<uint64_t> files;
+  leveldb::Status status = blobs_->seal(&files);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // What the files still hold that's pointed to. Values overwritten after the scan are still counted, which only makes
+  // the collection more conservative.
+  std::unordered_map<uint64_t, uint64_t> liveBytes;
+  if (!files.empty()) {
+    leveldb::ReadOptions readOptions;
+    // A one-off scan: don't evict the blocks that the app is actually using from the cache.
+    readOptions.fill_cache = false;
+    std::unique_ptr<leveldb::Iterator> it(newStoredIterator(readOptions));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+      uint64_t file, size;
+      if (Blob::isPointer(it->value())) {
+        Blob::pointee(it->value(), &file, &size);
+        liveBytes[file] += size;
+      }
+    }
+    if (!it->status().ok()) {
+      return it->status();
+    }
+  }
+
+  for (uint64_t file : files) {
+    uint64_t size = blobs_->fileSize(file);
+    uint64_t live = std::min(liveBytes[file], size);
+    if (live > 0 && (double)(size - live) < minGarbageRatio * (double)size) {
+      continue;
+    }
+    if (live > 0) {
+      status = moveLiveBlobs(file);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    blobs_->retire(file);
+    *reclaimedBytes += size - live;
+  }
+
+  // Also the files retired by previous collections. Iterators may still point to them, and get() may be about to read
+  // them, with its lock on the DB.
+  std::unique_lock<std::shared_timed_mutex> lock(dbMutex_);
+  if (db_.use_count() <= 1) {
+    blobs_->removeRetired();
+  }
+  return leveldb::Status::OK();
+}
+
+leveldb::Status DbHandle::moveLiveBlobs(uint64_t file) {
+  std::vector<std::pair<std::string, std::string>> records;
+  leveldb::Status status = blobs_->forEachRecord(file, [&](const leveldb::Slice& key, const std::string& pointer) {
+    records.emplace_back(key.ToString(), pointer);
+  });
+  if (!status.ok()) {
+    return status;
+  }
+
+  for (size_t next = 0; next < records.size();) {
+    // Writes wait, so that a value can't be overwritten between the check that it's still pointed to and the commit.
+    std::unique_lock<std::shared_timed_mutex> writeLock(writeMutex_);
+    leveldb::WriteBatch batch;
+    size_t moves = 0, movedBytes = 0;
+    for (; next < records.size() && movedBytes < kBlobGcChunkBytes; next++) {
+      const std::string& key = records[next].first;
+      std::string stored;
+      {
+        std::shared_lock<std::shared_timed_mutex> dbLock(dbMutex_, std::defer_lock);
+        status = getStored(leveldb::ReadOptions(), key, &stored, &dbLock);
+      }
+      if (status.IsNotFound() || (status.ok() && stored != records[next].second)) {
+        continue;
+      }
+      std::string value, moved;
+      if (status.ok()) {
+        status = blobs_->resolve(stored, &value);
+      }
+      if (status.ok()) {
+        status = blobs_->append(key, value, &moved);
+      }
+      if (!status.ok()) {
+        return status;
+      }
+      batch.Put(key, moved);
+      moves++;
+      movedBytes += value.size();
+    }
+    if (moves == 0) {
+      continue;
+    }
+
+    // Durable before the file they're moved from is removed. Committed directly: staged writes of these keys would
+    // have failed the check, and watchers aren't told, the values don't change.
+    status = blobs_->sync();
+    if (!status.ok()) {
+      return status;
+    }
+    leveldb::WriteOptions options;
+    options.sync = true;
+    std::shared_lock<std::shared_timed_mutex> dbLock(dbMutex_);
+    status = db_ ? db_->Write(options, &batch) : reopenFailed(path);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return leveldb::Status::OK();
+}
+
+void DbHandle::runFlusher() {
+  std::unique_lock<std::mutex> lock(pendingMutex_);
+  while (!stopFlusher_) {
+    if (pendingValues_.empty() || maxPendingBytes_.load() == 0) {
+      flusherCv_.wait(lock);
+      continue;
+    }
+
+    auto deadline = firstPendingWrite_ + maxPendingDelay_;
+    if (std::chrono::steady_clock::now() < deadline) {
+      flusherCv_.wait_until(lock, deadline);
+      continue;
+    }
+
+    leveldb::Status status = flushLocked(syncByDefault.load());
+    if (!status.ok()) {
+      flusherStatus_ = status;
+      // Back off for another delay before retrying, rather than spinning on a failing DB.
+      firstPendingWrite_ = std::chrono::steady_clock::now();
+    }
+  }
+}
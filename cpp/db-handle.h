@@ -0,0 +1,188 @@
+#ifndef db_handle_h
+#define db_handle_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <leveldb/comparator.h>
+#include <leveldb/db.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/write_batch.h>
+#include "blob.h"
+#include "checkpoint.h"
+#include "warmup.h"
+#include "watch.h"
+
+// How an open DB is tuned, see DbHandle::setProfile().
+enum class DbProfile {
+  kInteractive,
+  // For loading lots of data, e.g. on initial sync: a large memtable and large tables mean fewer level-0 flushes and
+  // fewer, larger compactions, so that writes rarely stall on them. LevelDB can't defer compactions outright, so
+  // switching back to kInteractive can compact the whole DB to pay off what's left.
+  kBulkLoad,
+};
+
+// An open DB. Opening the same path again (e.g. from another JS runtime) returns the same handle, so `openCount`
+// tracks how many leveldbClose() calls it takes to actually close it.
+//
+// All reads and writes go through the handle rather than the LevelDB DB directly, so that they observe writes that are
+// staged by write coalescing, but not yet committed to LevelDB, so that the DB can be reopened with another profile,
+// and so that large values can be kept in blob files (see Blob) transparently: writes separate them, and reads, through
+// get() and iterators alike, return the values pointed to.
+class DbHandle {
+ public:
+  // `options.filter_policy` must be `filterPolicy`, if any. It's released along with the DB, once the last iterator
+  // using the DB is gone too. Values of `blobThreshold` bytes or more are written to blob files, none with 0. Values
+  // already in blob files are read from them either way.
+  static leveldb::Status open(std::string path, const leveldb::Options& options,
+                              std::shared_ptr<const leveldb::FilterPolicy> filterPolicy, DbProfile profile,
+                              size_t blobThreshold, std::shared_ptr<DbHandle>* handle);
+  // Opens a read-only checkpoint of the DB at `source`, made at `path` (see Checkpoint), which works even while another
+  // process has the DB open. Reads see the DB as it was then. Writes fail with NotSupported. The checkpoint is removed
+  // once the DB closes.
+  static leveldb::Status openCheckpoint(const std::string& source, std::string path, const leveldb::Options& options,
+                                        std::shared_ptr<const leveldb::FilterPolicy> filterPolicy, DbProfile profile,
+                                        std::shared_ptr<DbHandle>* handle);
+  // Commits staged writes before the DB closes.
+  ~DbHandle();
+
+  const std::string path;
+  // Guarded by `openPathsMutex` in react-native-leveldb.cpp.
+  int openCount = 1;
+
+  // Subscriptions to the keys changed by the writes through the handle, whether committed or staged.
+  Watchers watchers;
+  // Records the reads through the handle after it opens, if asked to: get() records itself, reads through iterators
+  // are recorded by their callers, as ranges.
+  Warmup::Recorder warmupRecorder;
+
+  // The durability of writes that don't ask for one explicitly, see writeOptions().
+  std::atomic<bool> syncByDefault{false};
+  leveldb::WriteOptions writeOptions() const;
+
+  // Sync writes are fsynced before returning. Concurrent sync writers (e.g. from several runtimes) share an fsync:
+  // LevelDB commits the writers queued behind the current one as a group, with a single log sync. write() leaves the
+  // values of `batch` that go to blob files replaced by pointers to them.
+  leveldb::Status put(const leveldb::WriteOptions& options, const leveldb::Slice& key, const leveldb::Slice& value);
+  leveldb::Status del(const leveldb::WriteOptions& options, const leveldb::Slice& key);
+  leveldb::Status write(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch);
+  leveldb::Status get(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value);
+  // Calls `fill`, which may read through get(), and commits the batch that it fills, with no other write through the
+  // handle landing in between: e.g. to delete a key only if it still holds what was read. Nothing is committed if
+  // `fill` returns an error, which is then returned.
+  leveldb::Status update(const leveldb::WriteOptions& options,
+                         const std::function<leveldb::Status(leveldb::WriteBatch*)>& fill);
+  // Commits staged writes first, LevelDB iterators can't see them otherwise: if that fails, the iterator's status() is
+  // the error. The iterator keeps the DB open until it's deleted, even if the handle is destroyed first.
+  leveldb::Iterator* newIterator(const leveldb::ReadOptions& options);
+  uint64_t approximateSize(const leveldb::Range& range);
+  bool readOnly() const {
+    return checkpointDir_ != nullptr;
+  }
+  // The order of the keys.
+  const leveldb::Comparator* comparator() const {
+    return options_.comparator;
+  }
+
+  DbProfile profile();
+  // Reopens the DB with the tuning of `profile`, after waiting for in-flight reads and writes. Fails if iterators are
+  // open on the DB, since they'd keep it from closing. With `compact`, the whole DB is then compacted, which is what to
+  // do after a bulk load.
+  leveldb::Status setProfile(DbProfile profile, bool compact);
+
+  // With coalescing enabled, writes are staged in a WriteBatch that is committed once it grows past `maxBytes`, or
+  // `maxDelayMs` after the first staged write, whichever comes first. This amortizes LevelDB's per-write overhead
+  // (log append, writer queue hand-off) across many small writes. maxBytes == 0 disables coalescing.
+  // Staged writes are lost if the process crashes before they are committed. A sync write commits everything staged
+  // before it, so a single fsync makes all of it durable.
+  leveldb::Status setCoalescing(size_t maxBytes, int maxDelayMs);
+  // Commits staged writes. Also returns any error from a commit that happened in the background.
+  leveldb::Status flush(bool sync);
+
+  // Makes `dest`, which must not exist, a checkpoint of the DB (see Checkpoint) that holds every write made through the
+  // handle before the call, staged ones included. Writes wait until it's made, but not while it's checked: it's opened
+  // once, which replays its log, and made again if that fails.
+  leveldb::Status checkpoint(const std::string& dest);
+
+  // Reclaims the space taken by the values in blob files that were deleted or overwritten since. Blob files where they
+  // make up at least `minGarbageRatio` of the file are removed, after moving the values still used to the current
+  // file, a chunk at a time with writes held off. Files are removed right away unless iterators are open, which may
+  // still read them: then by the next collection, or once the DB closes. Sets `*reclaimedBytes` to the space that's
+  // freed.
+  leveldb::Status collectBlobGarbage(double minGarbageRatio, uint64_t* reclaimedBytes);
+
+ private:
+  // A staged write: the new value, or a delete.
+  struct PendingValue {
+    bool deleted;
+    std::string value;
+  };
+  class PendingValuesUpdater;
+  class BlobFinder;
+  class BlobSeparator;
+
+  DbHandle(std::string path, const leveldb::Options& options, std::shared_ptr<const leveldb::FilterPolicy> filterPolicy)
+      : path(std::move(path)),
+        watchers(options.comparator),
+        options_(options),
+        filterPolicy_(std::move(filterPolicy)) {}
+
+  // Opens `db_`, which must be null, with the tuning of `profile`. Reopens neither create the DB nor mind that it exists.
+  leveldb::Status openLocked(DbProfile profile, bool createIfMissing = false, bool errorIfExists = false);
+  leveldb::Status writeLocked(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch);
+  // Moves the values of `batch` that go to blob files there, leaving pointers to them in their place.
+  leveldb::Status separateBlobs(const leveldb::WriteOptions& options, leveldb::WriteBatch* batch);
+  // Reads the value of `key` as stored, which may be a pointer to a blob. Returns with `dbLock`, which must be
+  // unlocked, locked, so that the blob it points to can't be removed meanwhile.
+  leveldb::Status getStored(const leveldb::ReadOptions& options, const leveldb::Slice& key, std::string* value,
+                            std::shared_lock<std::shared_timed_mutex>* dbLock);
+  // Like newIterator(), over the values as stored.
+  leveldb::Iterator* newStoredIterator(const leveldb::ReadOptions& options);
+  leveldb::Status moveLiveBlobs(uint64_t file);
+  leveldb::Status flushLocked(bool sync);
+  void runFlusher();
+
+  // The options that the DB was opened with, before the profile is applied.
+  const leveldb::Options options_;
+  const std::shared_ptr<const leveldb::FilterPolicy> filterPolicy_;
+  // The checkpoint that a read-only DB was opened from. Like the filter policy, released along with the DB.
+  std::shared_ptr<const Checkpoint::TempDir> checkpointDir_;
+  // Shared with the iterators, which may read from it after the handle is gone.
+  std::shared_ptr<Blob::Store> blobs_;
+  // Held shared by writes, and exclusively by update() and setCoalescing(). Taken before `pendingMutex_`.
+  std::shared_timed_mutex writeMutex_;
+  // Held shared while using `db_`, and exclusively while reopening it or removing blob files. Taken after
+  // `pendingMutex_` when both are held.
+  std::shared_timed_mutex dbMutex_;
+  // Shared with the iterators, which keep it open. Null if a reopen failed.
+  std::shared_ptr<leveldb::DB> db_;
+  DbProfile profile_;
+
+  std::mutex pendingMutex_;
+  std::condition_variable flusherCv_;
+  std::thread flusher_;
+  bool stopFlusher_ = false;
+  // Written under `writeMutex_` and `pendingMutex_`, read without the latter to keep the uncoalesced path off it.
+  std::atomic<size_t> maxPendingBytes_{0};
+  std::chrono::milliseconds maxPendingDelay_{0};
+  std::chrono::steady_clock::time_point firstPendingWrite_;
+  leveldb::WriteBatch pending_;
+  std::unordered_map<std::string, PendingValue> pendingValues_;
+  // The error from the last background commit, if any, reported by the next write or flush.
+  leveldb::Status flusherStatus_;
+};
+
+struct IteratorHandle {
+  explicit IteratorHandle(leveldb::Iterator* iterator) : iterator(iterator) {}
+
+  const std::unique_ptr<leveldb::Iterator> iterator;
+};
+
+#endif /* db_handle_h */
@@ -0,0 +1,282 @@
+#include "dump.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace Dump {
+
+namespace {
+
+const char kMagic[8] = {'R', 'N', 'L', 'D', 'B', 'D', 'M', 'P'};
+const uint8_t kVersion = 1;
+const uint8_t kFlagCompressed = 1;
+// Blocks are flushed once they hold this many raw bytes. A single larger entry gets a block of its own.
+const size_t kBlockBytes = 64 * 1024;
+// Deflate can't expand data more than this many times.
+const uint64_t kMaxDeflateRatio = 1032;
+
+struct FileCloser {
+  void operator()(FILE* file) const {
+    fclose(file);
+  }
+};
+using File = std::unique_ptr<FILE, FileCloser>;
+
+leveldb::Status ioError(const std::string& context) {
+  return leveldb::Status::IOError(context, strerror(errno));
+}
+
+void putFixed32(std::string* dst, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    dst->push_back((char)((value >> (8 * i)) & 0xff));
+  }
+}
+
+uint32_t decodeFixed32(const char* src) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) {
+    value |= (uint32_t)(uint8_t)src[i] << (8 * i);
+  }
+  return value;
+}
+
+void putVarint32(std::string* dst, uint32_t value) {
+  while (value >= 0x80) {
+    dst->push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  dst->push_back((char)value);
+}
+
+// Returns false if `*pos` doesn't point to a complete varint within `data`.
+bool getVarint32(const std::string& data, size_t* pos, uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; shift <= 28 && *pos < data.size(); shift += 7) {
+    uint32_t byte = (uint8_t)data[(*pos)++];
+    *value |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+class BlockWriter {
+ public:
+  BlockWriter(FILE* file, bool compress) : file_(file), compress_(compress) {}
+
+  leveldb::Status add(const leveldb::Slice& key, const leveldb::Slice& value) {
+    putVarint32(&block_, (uint32_t)key.size());
+    block_.append(key.data(), key.size());
+    putVarint32(&block_, (uint32_t)value.size());
+    block_.append(value.data(), value.size());
+    entries_++;
+    return block_.size() >= kBlockBytes ? flush() : leveldb::Status::OK();
+  }
+
+  leveldb::Status finish() {
+    leveldb::Status status = flush();
+    if (!status.ok()) {
+      return status;
+    }
+    std::string trailer;
+    putFixed32(&trailer, 0);
+    putFixed32(&trailer, 8);
+    putFixed32(&trailer, (uint32_t)(entries_ & 0xffffffff));
+    putFixed32(&trailer, (uint32_t)(entries_ >> 32));
+    return write(trailer);
+  }
+
+  uint64_t entries() const {
+    return entries_;
+  }
+
+ private:
+  leveldb::Status flush() {
+    if (block_.empty()) {
+      return leveldb::Status::OK();
+    }
+    std::string header;
+    putFixed32(&header, (uint32_t)block_.size());
+    const std::string* stored = &block_;
+    if (compress_) {
+      uLongf compressedSize = compressBound(block_.size());
+      compressed_.resize(compressedSize);
+      if (compress2((Bytef*)&compressed_[0], &compressedSize, (const Bytef*)block_.data(), block_.size(), Z_BEST_SPEED) != Z_OK) {
+        return leveldb::Status::IOError("dump/compress-error");
+      }
+      compressed_.resize(compressedSize);
+      stored = &compressed_;
+    }
+    putFixed32(&header, (uint32_t)stored->size());
+    leveldb::Status status = write(header);
+    if (status.ok()) {
+      status = write(*stored);
+    }
+    block_.clear();
+    return status;
+  }
+
+  leveldb::Status write(const std::string& data) {
+    if (fwrite(data.data(), 1, data.size(), file_) != data.size()) {
+      return ioError("dump/write-error");
+    }
+    return leveldb::Status::OK();
+  }
+
+  FILE* file_;
+  bool compress_;
+  uint64_t entries_ = 0;
+  std::string block_;
+  std::string compressed_;
+};
+
+}  // namespace
+
+leveldb::Status exportTo(DbHandle& db, const std::string& path, const std::string* gte, const std::string* lt,
+                         bool compress, uint64_t* entries) {
+  std::string tmpPath = path + ".tmp";
+  File file(fopen(tmpPath.c_str(), "wb"));
+  if (!file) {
+    return ioError(tmpPath);
+  }
+
+  std::string header(kMagic, sizeof(kMagic));
+  header.push_back((char)kVersion);
+  header.push_back((char)(compress ? kFlagCompressed : 0));
+  if (fwrite(header.data(), 1, header.size(), file.get()) != header.size()) {
+    return ioError(tmpPath);
+  }
+
+  leveldb::ReadOptions readOptions;
+  readOptions.fill_cache = false;
+  std::unique_ptr<leveldb::Iterator> it(db.newIterator(readOptions));
+  BlockWriter writer(file.get(), compress);
+  leveldb::Status status;
+  for (gte ? it->Seek(*gte) : it->SeekToFirst(); status.ok() && it->Valid(); it->Next()) {
+    if (lt && db.comparator()->Compare(it->key(), *lt) >= 0) {
+      break;
+    }
+    status = writer.add(it->key(), it->value());
+  }
+  if (status.ok()) {
+    status = it->status();
+  }
+  if (status.ok()) {
+    status = writer.finish();
+  }
+  if (status.ok() && (fflush(file.get()) != 0 || fclose(file.release()) != 0)) {
+    status = ioError(tmpPath);
+  }
+  if (status.ok() && rename(tmpPath.c_str(), path.c_str()) != 0) {
+    status = ioError(path);
+  }
+  if (!status.ok()) {
+    file.reset();
+    remove(tmpPath.c_str());
+    return status;
+  }
+
+  *entries = writer.entries();
+  return status;
+}
+
+leveldb::Status importFrom(DbHandle& db, const std::string& path, size_t chunkBytes, uint64_t* entries) {
+  File file(fopen(path.c_str(), "rb"));
+  if (!file) {
+    return ioError(path);
+  }
+
+  char header[sizeof(kMagic) + 2];
+  if (fread(header, 1, sizeof(header), file.get()) != sizeof(header) || memcmp(header, kMagic, sizeof(kMagic)) != 0) {
+    return leveldb::Status::Corruption(path, "not a dump");
+  }
+  if ((uint8_t)header[sizeof(kMagic)] != kVersion) {
+    return leveldb::Status::NotSupported(path, "unknown dump version");
+  }
+  bool compressed = header[sizeof(kMagic) + 1] & kFlagCompressed;
+  struct stat st;
+  if (fstat(fileno(file.get()), &st) != 0) {
+    return ioError(path);
+  }
+  uint64_t left = (uint64_t)st.st_size - sizeof(header);
+
+  leveldb::WriteBatch batch;
+  std::string stored, block;
+  uint64_t imported = 0;
+  while (true) {
+    char blockHeader[8];
+    if (fread(blockHeader, 1, sizeof(blockHeader), file.get()) != sizeof(blockHeader)) {
+      return leveldb::Status::Corruption(path, "truncated dump");
+    }
+    uint32_t rawSize = decodeFixed32(blockHeader), storedSize = decodeFixed32(blockHeader + 4);
+    // Checked before allocating anything, so that a corrupt dump fails the import rather than exhausting memory. Entries
+    // aren't limited in size, and neither are blocks, but their stored bytes must be in the file, and inflating them
+    // can only get so far.
+    left -= std::min<uint64_t>(left, sizeof(blockHeader));
+    if (storedSize > left ||
+        (rawSize != 0 && (compressed ? rawSize > storedSize * kMaxDeflateRatio : rawSize != storedSize))) {
+      return leveldb::Status::Corruption(path, "bad block size");
+    }
+    left -= storedSize;
+    stored.resize(storedSize);
+    if (storedSize > 0 && fread(&stored[0], 1, storedSize, file.get()) != storedSize) {
+      return leveldb::Status::Corruption(path, "truncated dump");
+    }
+
+    if (rawSize == 0) {
+      // The trailer: make sure that we saw every entry.
+      if (storedSize != 8 || (decodeFixed32(&stored[0]) | (uint64_t)decodeFixed32(&stored[4]) << 32) != imported) {
+        return leveldb::Status::Corruption(path, "entry count mismatch");
+      }
+      break;
+    }
+
+    if (compressed) {
+      block.resize(rawSize);
+      uLongf size = rawSize;
+      if (uncompress((Bytef*)&block[0], &size, (const Bytef*)stored.data(), storedSize) != Z_OK || size != rawSize) {
+        return leveldb::Status::Corruption(path, "bad compressed block");
+      }
+    } else {
+      block.swap(stored);
+    }
+
+    size_t pos = 0;
+    while (pos < block.size()) {
+      uint32_t keySize, valueSize;
+      if (!getVarint32(block, &pos, &keySize) || block.size() - pos < keySize) {
+        return leveldb::Status::Corruption(path, "bad entry");
+      }
+      leveldb::Slice key(block.data() + pos, keySize);
+      pos += keySize;
+      if (!getVarint32(block, &pos, &valueSize) || block.size() - pos < valueSize) {
+        return leveldb::Status::Corruption(path, "bad entry");
+      }
+      batch.Put(key, leveldb::Slice(block.data() + pos, valueSize));
+      pos += valueSize;
+      imported++;
+    }
+
+    if (batch.ApproximateSize() >= chunkBytes) {
+      leveldb::Status status = db.write(db.writeOptions(), &batch);
+      if (!status.ok()) {
+        return status;
+      }
+      batch.Clear();
+    }
+  }
+
+  leveldb::Status status = db.write(db.writeOptions(), &batch);
+  if (status.ok()) {
+    *entries = imported;
+  }
+  return status;
+}
+
+}  // namespace Dump
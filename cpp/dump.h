@@ -0,0 +1,27 @@
+#ifndef dump_h
+#define dump_h
+
+#include <string>
+#include <leveldb/status.h>
+#include "db-handle.h"
+
+// A compact single-file dump of a DB's entries, used to back up, migrate or seed DBs.
+//
+// The file starts with an 8-byte magic, a version byte and a flags byte. Then come blocks, each made of a fixed32
+// raw size, a fixed32 stored size and the stored bytes, which are zlib-deflated if the flags say so. A block holds
+// whole entries, each a varint32 key length, the key, a varint32 value length and the value (as stored in LevelDB, i.e.
+// msgpack). A block with a raw size of 0 ends the dump; it's followed by the fixed64 number of entries, which lets
+// imports detect truncated files.
+//
+// Both directions stream block by block, so memory use doesn't depend on the size of the DB.
+namespace Dump {
+  // Writes the entries of `db` in [gte, lt) to `path`, from a consistent snapshot. Either bound may be null.
+  // The dump is written next to `path` and renamed into place once complete.
+  leveldb::Status exportTo(DbHandle& db, const std::string& path, const std::string* gte, const std::string* lt,
+                           bool compress, uint64_t* entries);
+
+  // Writes the entries dumped in `path` to `db`, committing them in batches of about `chunkBytes`.
+  leveldb::Status importFrom(DbHandle& db, const std::string& path, size_t chunkBytes, uint64_t* entries);
+}
+
+#endif /* dump_h */
@@ -0,0 +1,145 @@
+#include "file-reader.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+#ifdef LEVELDB_JSI_HAS_MUTABLE_BUFFER
+// A slice of a mapping, handed to JS without copying.
+class MappedSlice : public jsi::MutableBuffer {
+ public:
+  MappedSlice(std::shared_ptr<MappedFile> file, uint64_t pos, size_t size) : file_(std::move(file)), pos_(pos), size_(size) {}
+
+  size_t size() const override {
+    return size_;
+  }
+  uint8_t* data() override {
+    return (uint8_t*)file_->data() + pos_;
+  }
+
+ private:
+  std::shared_ptr<MappedFile> file_;
+  uint64_t pos_;
+  size_t size_;
+};
+#endif
+
+}  // namespace
+
+jsi::Object newArrayBuffer(jsi::Runtime& runtime, const char* data, size_t size) {
+  jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
+  jsi::Object o = arrayBufferCtor.callAsConstructor(runtime, (double)size).getObject(runtime);
+  jsi::ArrayBuffer buf = o.getArrayBuffer(runtime);
+  memcpy(buf.data(runtime), data, size);
+  return o;
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path, std::string* err) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *err = "open-error/" + std::string(strerror(errno));
+    return nullptr;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    *err = "stat-error/" + std::string(strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+  // Can't be mapped whole on 32-bit ABIs.
+  if ((uint64_t)st.st_size > SIZE_MAX) {
+    *err = "file-too-large";
+    close(fd);
+    return nullptr;
+  }
+
+  char* data = nullptr;
+  if (st.st_size > 0) {
+    void* mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      *err = "mmap-error/" + std::string(strerror(errno));
+      close(fd);
+      return nullptr;
+    }
+    data = (char*)mapped;
+    // Attachments are mostly streamed front to back.
+    madvise(mapped, (size_t)st.st_size, MADV_SEQUENTIAL);
+  }
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  return std::shared_ptr<MappedFile>(new MappedFile(data, (uint64_t)st.st_size));
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(data_, (size_t)size_);
+  }
+}
+
+jsi::Value FileReaderHostObject::get(jsi::Runtime& runtime, const jsi::PropNameID& name) {
+  std::string prop = name.utf8(runtime);
+
+  std::shared_ptr<State> state = state_;
+
+  if (prop == "size") {
+    if (!state->file) {
+      throw jsi::JSError(runtime, "leveldbFileReader/closed");
+    }
+    return jsi::Value((double)state->file->size());
+  }
+
+  if (prop == "read") {
+    return jsi::Function::createFromHostFunction(
+        runtime,
+        name,
+        2,  // pos, len
+        [state](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+          std::shared_ptr<MappedFile> file = state->file;
+          if (!file) {
+            throw jsi::JSError(runtime, "leveldbFileReader/closed");
+          }
+          if (count < 2 || !arguments[0].isNumber() || !arguments[1].isNumber()
+              || arguments[0].getNumber() < 0 || arguments[1].getNumber() < 0) {
+            throw jsi::JSError(runtime, "leveldbFileReader/invalid-params");
+          }
+          uint64_t pos = (uint64_t)arguments[0].getNumber(), len = (uint64_t)arguments[1].getNumber();
+          if (pos > file->size() || len > file->size() - pos) {
+            throw jsi::JSError(runtime, "leveldbFileReader/invalid-len-plus-pos");
+          }
+
+#ifdef LEVELDB_JSI_HAS_MUTABLE_BUFFER
+          return jsi::ArrayBuffer(runtime, std::make_shared<MappedSlice>(file, pos, (size_t)len));
+#else
+          return newArrayBuffer(runtime, file->data() + pos, (size_t)len);
+#endif
+        });
+  }
+
+  if (prop == "close") {
+    return jsi::Function::createFromHostFunction(
+        runtime,
+        name,
+        0,
+        [state](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+          state->file.reset();
+          return nullptr;
+        });
+  }
+
+  return jsi::Value::undefined();
+}
+
+std::vector<jsi::PropNameID> FileReaderHostObject::getPropertyNames(jsi::Runtime& runtime) {
+  std::vector<jsi::PropNameID> names;
+  names.push_back(jsi::PropNameID::forAscii(runtime, "size"));
+  names.push_back(jsi::PropNameID::forAscii(runtime, "read"));
+  names.push_back(jsi::PropNameID::forAscii(runtime, "close"));
+  return names;
+}
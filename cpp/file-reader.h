@@ -0,0 +1,57 @@
+#ifndef file_reader_h
+#define file_reader_h
+
+#include <memory>
+#include <string>
+#include <jsi/jsi.h>
+
+using namespace facebook;
+
+// Copies `size` bytes from `data` into a new ArrayBuffer.
+jsi::Object newArrayBuffer(jsi::Runtime& runtime, const char* data, size_t size);
+
+// A read-only view of a whole file, mapped into memory once.
+class MappedFile {
+ public:
+  // Returns nullptr and sets `*err` if the file can't be opened or mapped.
+  static std::shared_ptr<MappedFile> open(const std::string& path, std::string* err);
+  ~MappedFile();
+
+  const char* data() const {
+    return data_;
+  }
+  uint64_t size() const {
+    return size_;
+  }
+
+ private:
+  MappedFile(char* data, uint64_t size) : data_(data), size_(size) {}
+
+  // Mapped copy-on-write, so that writes to zero-copy views never reach the file.
+  char* data_;
+  uint64_t size_;
+};
+
+// The JS side of a MappedFile: `size`, `read(pos, len)` and `close()`. Offsets are 64-bit (well, up to 2^53).
+//
+// read() returns a new ArrayBuffer holding a copy of the requested bytes. When built with
+// LEVELDB_JSI_HAS_MUTABLE_BUFFER (which needs a JSI version that can wrap native memory in an ArrayBuffer, RN 0.72+),
+// it returns a zero-copy view of the mapping instead, which keeps the mapping alive until it's garbage collected.
+class FileReaderHostObject : public jsi::HostObject {
+ public:
+  explicit FileReaderHostObject(std::shared_ptr<MappedFile> file) : state_(std::make_shared<State>()) {
+    state_->file = std::move(file);
+  }
+
+  jsi::Value get(jsi::Runtime& runtime, const jsi::PropNameID& name) override;
+  std::vector<jsi::PropNameID> getPropertyNames(jsi::Runtime& runtime) override;
+
+ private:
+  // Shared with the functions that get() hands out, which may outlive the host object.
+  struct State {
+    std::shared_ptr<MappedFile> file;
+  };
+  std::shared_ptr<State> state_;
+};
+
+#endif /* file_reader_h */
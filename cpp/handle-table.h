@@ -0,0 +1,97 @@
+#ifndef handle_table_h
+#define handle_table_h
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Maps the integer handles that we hand out to JS onto native objects, e.g. DBs and iterators.
+//
+// Handles are plain numbers, so they can be passed between JS runtimes (e.g. from the main runtime into a worklet
+// runtime). The table is split into shards, each guarded by its own mutex, so that runtimes working on different
+// handles don't contend on a single lock. Lookups hand out a shared_ptr, which keeps the object alive for the
+// duration of a call even if another runtime removes it concurrently.
+template <typename T, size_t kShards = 16>
+class HandleTable {
+ public:
+  int add(std::shared_ptr<T> value) {
+    int idx = next_.fetch_add(1);
+    Shard& shard = shardFor(idx);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.items[idx] = std::move(value);
+    return idx;
+  }
+
+  // Returns nullptr if `idx` is unknown or was removed.
+  std::shared_ptr<T> get(int idx) {
+    if (idx < 0) {
+      return nullptr;
+    }
+    Shard& shard = shardFor(idx);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.items.find(idx);
+    return it == shard.items.end() ? nullptr : it->second;
+  }
+
+  // Returns the removed object, or nullptr if `idx` wasn't in the table.
+  std::shared_ptr<T> remove(int idx) {
+    if (idx < 0) {
+      return nullptr;
+    }
+    Shard& shard = shardFor(idx);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.items.find(idx);
+    if (it == shard.items.end()) {
+      return nullptr;
+    }
+    std::shared_ptr<T> value = std::move(it->second);
+    shard.items.erase(it);
+    return value;
+  }
+
+  // True if `idx` was handed out by this table at some point, whether or not it was removed since.
+  bool issued(int idx) const {
+    return idx >= 0 && idx < next_.load();
+  }
+
+  // Returns a snapshot of all objects currently in the table.
+  std::vector<std::shared_ptr<T>> values() {
+    std::vector<std::shared_ptr<T>> result;
+    for (Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto& item : shard.items) {
+        result.push_back(item.second);
+      }
+    }
+    return result;
+  }
+
+  void clear() {
+    for (Shard& shard : shards_) {
+      // Destroy the objects outside of the lock, their destructors may be slow (e.g. closing a DB).
+      std::unordered_map<int, std::shared_ptr<T>> items;
+      {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        items.swap(shard.items);
+      }
+    }
+  }
+
+ private:
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<int, std::shared_ptr<T>> items;
+  };
+
+  Shard& shardFor(int idx) {
+    return shards_[(size_t)idx % kShards];
+  }
+
+  std::atomic<int> next_{0};
+  std::array<Shard, kShards> shards_;
+};
+
+#endif /* handle_table_h */
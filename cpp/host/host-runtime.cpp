@@ -0,0 +1,94 @@
+#include "host-runtime.h"
+
+#include <cstdlib>
+#include <stdexcept>
+#include <hermes/hermes.h>
+#include "../react-native-leveldb.h"
+
+void QueueCallInvoker::invokeAsync(std::function<void()>&& func) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(func));
+  }
+  cv_.notify_all();
+}
+
+void QueueCallInvoker::invokeSync(std::function<void()>&& func) {
+  func();
+}
+
+void QueueCallInvoker::drain() {
+  drainUntil([] { return true; });
+}
+
+void QueueCallInvoker::drainUntil(const std::function<bool()>& done) {
+  while (true) {
+    std::function<void()> func;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (queue_.empty()) {
+        // `done` may run JS, which may queue more work: don't hold the lock.
+        lock.unlock();
+        if (done()) {
+          return;
+        }
+        lock.lock();
+        cv_.wait(lock, [this] { return !queue_.empty(); });
+      }
+      func = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    func();
+  }
+}
+
+HostRuntime::HostRuntime() : invoker_(std::make_shared<QueueCallInvoker>()) {
+  char dir[] = "/tmp/rnleveldb-XXXXXX";
+  if (!mkdtemp(dir)) {
+    throw std::runtime_error("HostRuntime/mkdtemp-failed");
+  }
+  documentDir_ = dir;
+  // Promise callbacks run as microtasks, which await() drains after each piece of queued work.
+  runtime_ = facebook::hermes::makeHermesRuntime(::hermes::vm::RuntimeConfig::Builder().withMicrotaskQueue(true).build());
+  installLeveldb(*runtime_, documentDir_, invoker_);
+}
+
+HostRuntime::~HostRuntime() {
+  cleanupLeveldb(*runtime_);
+  // Let pending deletions of JS values run before the runtime goes away.
+  invoker_->drain();
+  runtime_.reset();
+  std::string rm = "rm -rf '" + documentDir_ + "'";
+  std::system(rm.c_str());
+}
+
+jsi::Value HostRuntime::eval(const std::string& code) {
+  return runtime_->evaluateJavaScript(std::make_shared<jsi::StringBuffer>(code), "host-runtime");
+}
+
+jsi::Value HostRuntime::await(const jsi::Value& promise) {
+  jsi::Runtime& rt = runtime();
+  auto settled = std::make_shared<bool>(false);
+  auto rejected = std::make_shared<bool>(false);
+  auto result = std::make_shared<jsi::Value>();
+  auto settle = [&rt, settled, rejected, result](bool rejection) {
+    return jsi::Function::createFromHostFunction(rt, jsi::PropNameID::forAscii(rt, "settle"), 1,
+        [settled, rejected, result, rejection](jsi::Runtime& runtime, const jsi::Value&, const jsi::Value* arguments,
+                                               size_t count) -> jsi::Value {
+          *settled = true;
+          *rejected = rejection;
+          *result = count > 0 ? jsi::Value(runtime, arguments[0]) : jsi::Value();
+          return jsi::Value();
+        });
+  };
+  promise.asObject(rt).getPropertyAsFunction(rt, "then").callWithThis(rt, promise.asObject(rt), settle(false), settle(true));
+
+  invoker_->drainUntil([&rt, settled] {
+    rt.drainMicrotasks();
+    return *settled;
+  });
+  if (*rejected) {
+    throw jsi::JSError(rt, jsi::Value(rt, *result));
+  }
+  return std::move(*result);
+}
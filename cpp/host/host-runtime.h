@@ -0,0 +1,65 @@
+#ifndef host_runtime_h
+#define host_runtime_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <jsi/jsi.h>
+#include <ReactCommon/CallInvoker.h>
+
+using namespace facebook;
+
+// Stands in for React Native's JS thread on host builds: work scheduled by the native core is queued until the test
+// or benchmark calls drain() from the thread that owns the runtime.
+class QueueCallInvoker : public react::CallInvoker {
+ public:
+  void invokeAsync(std::function<void()>&& func) override;
+  void invokeSync(std::function<void()>&& func) override;
+
+  // Runs queued work until the queue is empty.
+  void drain();
+  // Runs queued work until `done` returns true, waiting for background jobs to queue more.
+  void drainUntil(const std::function<bool()>& done);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+};
+
+// A Hermes runtime with the leveldb* functions installed, with DBs stored in a fresh temporary directory.
+class HostRuntime {
+ public:
+  HostRuntime();
+  ~HostRuntime();
+
+  jsi::Runtime& runtime() {
+    return *runtime_;
+  }
+  QueueCallInvoker& invoker() {
+    return *invoker_;
+  }
+  const std::string& documentDir() const {
+    return documentDir_;
+  }
+
+  jsi::Value eval(const std::string& code);
+  // Runs queued JS-thread work and microtasks until `promise` settles. Returns its value, or throws a jsi::JSError
+  // with the rejection reason.
+  jsi::Value await(const jsi::Value& promise);
+  // Calls the global function `name`.
+  template <typename... Args>
+  jsi::Value call(const char* name, Args&&... args) {
+    return runtime().global().getPropertyAsFunction(runtime(), name).call(runtime(), std::forward<Args>(args)...);
+  }
+
+ private:
+  std::string documentDir_;
+  std::shared_ptr<QueueCallInvoker> invoker_;
+  std::unique_ptr<jsi::Runtime> runtime_;
+};
+
+#endif /* host_runtime_h */
@@ -0,0 +1,260 @@
+// Benchmarks of the hot paths of the native core: msgpack encoding/decoding, and the leveldb* functions as called from
+// JS, across payload shapes. Run with e.g. --benchmark_repetitions=5 --benchmark_out=results.json, and compare two
+// runs with Google Benchmark's tools/compare.py.
+#include <random>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "host-runtime.h"
+#include "../packer.h"
+
+namespace {
+
+struct Payload {
+  const char* name;
+  const char* js;
+};
+
+const Payload kPayloads[] = {
+    {"short-string", "'x'.repeat(100)"},
+    {"flat-object", "({id: 'msg_1234567890', ts: 1660000000000, read: false, score: 0.75, author: 'someone@example.com',"
+                    " subject: 'Re: hello', tags: null, size: 4096, draft: true, folder: 'inbox'})"},
+    {"nested-object", "({thread: {id: 't1', participants: ['a', 'b', 'c']}, messages: Array.from({length: 20},"
+                      " (_, i) => ({id: 'm' + i, ts: 1660000000000 + i, body: 'hello '.repeat(10), meta: {i}}))})"},
+    {"number-array", "Array.from({length: 1000}, (_, i) => i * 1.5)"},
+    {"large-string", "'x'.repeat(100 * 1024)"},
+};
+const int kNumPayloads = sizeof(kPayloads) / sizeof(kPayloads[0]);
+const int kNumKeys = 10000;
+
+HostRuntime& host() {
+  static HostRuntime* host = new HostRuntime();
+  return *host;
+}
+
+jsi::Value payload(benchmark::State& state) {
+  const Payload& p = kPayloads[state.range(0)];
+  state.SetLabel(p.name);
+  return host().eval(p.js);
+}
+
+std::string encode(jsi::Runtime& runtime, const jsi::Value& value) {
+  mpack_writer_t writer;
+  char* buf;
+  size_t size;
+  mpack_writer_init_growable(&writer, &buf, &size);
+  Packer::pack(value, runtime, &writer);
+  mpack_writer_destroy(&writer);
+  std::string encoded(buf, size);
+  MPACK_FREE(buf);
+  return encoded;
+}
+
+std::string key(int i) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "key%08d", i);
+  return buf;
+}
+
+// Opens a fresh DB, filled with kNumKeys copies of `value` if `fill` is set.
+jsi::Value openDb(const jsi::Value& value, bool fill) {
+  static int dbs = 0;
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = host().call("leveldbOpen", jsi::String::createFromAscii(runtime, "bench" + std::to_string(dbs++)), true, true);
+  if (fill) {
+    jsi::Object record(runtime);
+    for (int i = 0; i < kNumKeys; i++) {
+      record.setProperty(runtime, key(i).c_str(), jsi::Value(runtime, value));
+    }
+    host().call("leveldbBatchObjects", jsi::Value(runtime, db), std::move(record), jsi::Array(runtime, 0));
+  }
+  return db;
+}
+
+void BM_Encode(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value value = payload(state);
+  size_t bytes = encode(runtime, value).size();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(encode(runtime, value));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_Encode)->DenseRange(0, kNumPayloads - 1);
+
+void BM_Decode(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  std::string encoded = encode(runtime, payload(state));
+  for (auto _ : state) {
+    mpack_reader_t reader;
+    mpack_reader_init_data(&reader, encoded.data(), encoded.size());
+    benchmark::DoNotOptimize(Packer::unpackElement(runtime, &reader, 0));
+    mpack_reader_destroy(&reader);
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+}
+BENCHMARK(BM_Decode)->DenseRange(0, kNumPayloads - 1);
+
+void BM_Put(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value value = payload(state);
+  jsi::Value db = openDb(value, false);
+  int i = 0;
+  for (auto _ : state) {
+    host().call("leveldbPut", jsi::Value(runtime, db), jsi::String::createFromAscii(runtime, key(i++ % kNumKeys)), jsi::Value(runtime, value));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Put)->DenseRange(0, kNumPayloads - 1);
+
+void BM_Get(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = openDb(payload(state), true);
+  // Fixed seed, so that runs are comparable.
+  std::mt19937 rng(42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(host().call("leveldbGet", jsi::Value(runtime, db), jsi::String::createFromAscii(runtime, key(rng() % kNumKeys))));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Get)->DenseRange(0, kNumPayloads - 1);
+
+void BM_BatchObjects(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value value = payload(state);
+  jsi::Value db = openDb(value, false);
+  jsi::Object record(runtime);
+  for (int i = 0; i < 1000; i++) {
+    record.setProperty(runtime, key(i).c_str(), jsi::Value(runtime, value));
+  }
+  for (auto _ : state) {
+    host().call("leveldbBatchObjects", jsi::Value(runtime, db), jsi::Value(runtime, record), jsi::Array(runtime, 0));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_BatchObjects)->DenseRange(0, kNumPayloads - 1);
+
+// Times only what leveldbBatchObjectsAsync() keeps the JS thread busy with, compare with BM_BatchObjects.
+void BM_BatchObjectsAsync(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value value = payload(state);
+  jsi::Value db = openDb(value, false);
+  jsi::Object record(runtime);
+  for (int i = 0; i < 1000; i++) {
+    record.setProperty(runtime, key(i).c_str(), jsi::Value(runtime, value));
+  }
+  for (auto _ : state) {
+    jsi::Value promise = host().call("leveldbBatchObjectsAsync", jsi::Value(runtime, db), jsi::Value(runtime, record),
+                                     jsi::Array(runtime, 0));
+    state.PauseTiming();
+    host().await(promise);
+    state.ResumeTiming();
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_BatchObjectsAsync)->DenseRange(0, kNumPayloads - 1);
+
+// Writes 1000 numbers in one call, as an array of values (0) or as a Float64Array (1).
+void BM_PutMany(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = openDb(jsi::Value(), false);
+  jsi::Value keys = host().eval("Array.from({length: 1000}, (_, i) => 'ts' + String(i).padStart(8, '0'))");
+  jsi::Value values = host().eval(state.range(0) == 0 ? "Array.from({length: 1000}, (_, i) => i * 1.5)"
+                                                      : "Float64Array.from({length: 1000}, (_, i) => i * 1.5)");
+  state.SetLabel(state.range(0) == 0 ? "array" : "Float64Array");
+  for (auto _ : state) {
+    host().call("leveldbPutMany", jsi::Value(runtime, db), jsi::Value(runtime, keys), jsi::Value(runtime, values));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * 1000);
+}
+BENCHMARK(BM_PutMany)->DenseRange(0, 1);
+
+void BM_Scan(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = openDb(payload(state), true);
+  for (auto _ : state) {
+    jsi::Value it = host().call("leveldbNewIterator", jsi::Value(runtime, db));
+    for (host().call("leveldbIteratorSeekToFirst", jsi::Value(runtime, it));
+         host().call("leveldbIteratorValid", jsi::Value(runtime, it)).getBool();
+         host().call("leveldbIteratorNext", jsi::Value(runtime, it))) {
+      benchmark::DoNotOptimize(host().call("leveldbIteratorKeyStr", jsi::Value(runtime, it)));
+      benchmark::DoNotOptimize(host().call("leveldbIteratorValueBuf", jsi::Value(runtime, it)));
+    }
+    host().call("leveldbIteratorDelete", std::move(it));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * kNumKeys);
+}
+BENCHMARK(BM_Scan)->DenseRange(0, kNumPayloads - 1)->Unit(benchmark::kMillisecond);
+
+void BM_GetAllObjects(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = openDb(payload(state), true);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(host().call("leveldbGetAllObjects", jsi::Value(runtime, db)));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * kNumKeys);
+}
+BENCHMARK(BM_GetAllObjects)->DenseRange(0, kNumPayloads - 1)->Unit(benchmark::kMillisecond);
+
+void BM_GetAllObjectsAsync(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  jsi::Value db = openDb(payload(state), true);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(host().await(host().call("leveldbGetAllObjectsAsync", jsi::Value(runtime, db))));
+  }
+  host().call("leveldbClose", std::move(db));
+  state.SetItemsProcessed(state.iterations() * kNumKeys);
+}
+BENCHMARK(BM_GetAllObjectsAsync)->DenseRange(0, kNumPayloads - 1)->Unit(benchmark::kMillisecond);
+
+// Loads 256MB in batches of 1000 1KB objects, as an initial sync would, into a fresh DB opened with the interactive
+// (0) or bulk load (1) profile. The bulk load is timed up to and including the switch back to the interactive profile,
+// with its compaction.
+void BM_BulkLoad(benchmark::State& state) {
+  jsi::Runtime& runtime = host().runtime();
+  const int kBatches = 256;
+  std::vector<jsi::Object> batches;
+  jsi::Value value = host().eval("'x'.repeat(1024)");
+  for (int batch = 0; batch < kBatches; batch++) {
+    jsi::Object record(runtime);
+    for (int i = 0; i < 1000; i++) {
+      record.setProperty(runtime, key(batch * 1000 + i).c_str(), jsi::Value(runtime, value));
+    }
+    batches.push_back(std::move(record));
+  }
+  const char* profile = state.range(0) == 1 ? "bulkLoad" : "interactive";
+  state.SetLabel(profile);
+
+  int loads = 0;
+  for (auto _ : state) {
+    std::string name = "bulk" + std::to_string(loads++);
+    jsi::Object openOptions(runtime);
+    openOptions.setProperty(runtime, "profile", jsi::String::createFromAscii(runtime, profile));
+    jsi::Value db = host().call("leveldbOpen", jsi::String::createFromAscii(runtime, name), true, true, std::move(openOptions));
+    for (const jsi::Object& batch : batches) {
+      host().call("leveldbBatchObjects", jsi::Value(runtime, db), jsi::Value(runtime, batch), jsi::Array(runtime, 0));
+    }
+    if (state.range(0) == 1) {
+      jsi::Value switched = host().call("leveldbSetProfileAsync", jsi::Value(runtime, db),
+                                        jsi::String::createFromAscii(runtime, "interactive"), true);
+      host().await(switched);
+    }
+
+    state.PauseTiming();
+    host().call("leveldbClose", std::move(db));
+    host().call("leveldbDestroy", jsi::String::createFromAscii(runtime, name));
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * kBatches * 1000 * 1024);
+}
+BENCHMARK(BM_BulkLoad)->DenseRange(0, 1)->Unit(benchmark::kMillisecond)->Iterations(3);
+
+}  // namespace
+
+BENCHMARK_MAIN();
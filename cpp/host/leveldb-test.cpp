@@ -0,0 +1,918 @@
+// Tests of the leveldb* functions, called from JS as the app does. Each test gets a fresh runtime, with its DBs in a
+// fresh directory, available to JS as `dir`.
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <dirent.h>
+#include <gtest/gtest.h>
+#include "host-runtime.h"
+
+namespace {
+
+class LeveldbTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    eval("var dir = '" + host.documentDir() + "/';");
+  }
+
+  jsi::Runtime& rt() {
+    return host.runtime();
+  }
+  jsi::Value eval(const std::string& code) {
+    return host.eval(code);
+  }
+  std::string str(const std::string& code) {
+    return eval(code).asString(rt()).utf8(rt());
+  }
+  // JSON.stringify(code), to compare objects and arrays.
+  std::string json(const std::string& code) {
+    return str("JSON.stringify(" + code + ")");
+  }
+  double num(const std::string& code) {
+    return eval(code).asNumber();
+  }
+  bool boolean(const std::string& code) {
+    return eval(code).getBool();
+  }
+  // Returns the message of the error that `code` throws, or "" if it doesn't.
+  std::string error(const std::string& code) {
+    try {
+      eval(code);
+    } catch (const jsi::JSError& e) {
+      return e.getMessage();
+    }
+    return "";
+  }
+  jsi::Value await(const std::string& code) {
+    return host.await(eval(code));
+  }
+  // Writes `data` to the file `name` in `dir`.
+  void writeFile(const std::string& name, const std::string& data) {
+    FILE* file = fopen((host.documentDir() + "/" + name).c_str(), "wb");
+    ASSERT_TRUE(file);
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+  }
+
+  HostRuntime host;
+};
+
+TEST_F(LeveldbTest, Open) {
+  eval("var db = leveldbOpen('a.db', true, true);");
+  EXPECT_TRUE(eval("db").isNumber());
+  // Opening an open path again shares its handle, and takes one more close to close it.
+  EXPECT_EQ(num("leveldbOpen('a.db', true, false)"), num("db"));
+  eval("leveldbClose(db);");
+  EXPECT_TRUE(eval("leveldbGet(db, 'k')").isNull());
+  eval("leveldbClose(db);");
+  EXPECT_NE(error("leveldbGet(db, 'k')").find("db-closed"), std::string::npos);
+
+  EXPECT_NE(error("leveldbOpen('a.db', true, true)").find("exists"), std::string::npos);
+  EXPECT_NE(error("leveldbOpen('missing.db', false, false)"), "");
+  EXPECT_EQ(error("leveldbOpen(1, true, true)"), "leveldbOpen/invalid-params");
+}
+
+TEST_F(LeveldbTest, OpenWithSyncOption) {
+  eval("var db = leveldbOpen('a.db', true, true, {sync: true}); leveldbPut(db, 'k', 1);");
+  EXPECT_EQ(num("leveldbGet(db, 'k')"), 1);
+}
+
+TEST_F(LeveldbTest, OpenWithTuningOptions) {
+  eval("var lookups = leveldbOpen('lookups.db', true, true, {bloomBitsPerKey: 14, blockSize: 16384});"
+       "var scans = leveldbOpen('scans.db', true, true, {bloomBitsPerKey: 0, writeBufferSize: 8 << 20,"
+       " maxOpenFiles: 100});"
+       "var shared1 = leveldbOpen('shared1.db', true, true, {sharedFilterPolicy: true});"
+       "var shared2 = leveldbOpen('shared2.db', true, true, {sharedFilterPolicy: true});"
+       "[lookups, scans, shared1, shared2].forEach(db => leveldbPut(db, 'k', 1));");
+  EXPECT_EQ(json("[lookups, scans, shared1, shared2].map(db => leveldbGet(db, 'k'))"), "[1,1,1,1]");
+  // The shared policy outlives the first DB that used it.
+  eval("leveldbClose(shared1); leveldbPut(shared2, 'k', 2);");
+  EXPECT_EQ(num("leveldbGet(shared2, 'k')"), 2);
+
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {bloomBitsPerKey: -1})"), "leveldbOpen/invalid-options");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {blockSize: 0})"), "leveldbOpen/invalid-options");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {maxOpenFiles: 'many'})"), "leveldbOpen/invalid-options");
+}
+
+TEST_F(LeveldbTest, SetProfile) {
+  eval("var db = leveldbOpen('a.db', true, true, {profile: 'bulkLoad'});"
+       "for (var i = 0; i < 1000; i++) leveldbPut(db, 'k' + i, 'x'.repeat(1000));");
+  await("leveldbSetProfileAsync(db, 'interactive', true)");
+  EXPECT_EQ(num("Object.keys(leveldbGetAllObjects(db)).length"), 1000);
+
+  // Coalesced writes are committed before the reopen.
+  eval("leveldbSetWriteCoalescing(db, 1 << 20, 60 * 1000); leveldbPut(db, 'staged', 1);");
+  await("leveldbSetProfileAsync(db, 'bulkLoad')");
+  EXPECT_EQ(num("leveldbGet(db, 'staged')"), 1);
+
+  eval("var it = leveldbNewIterator(db);");
+  EXPECT_THROW(await("leveldbSetProfileAsync(db, 'interactive')"), jsi::JSError);
+  eval("leveldbIteratorDelete(it);");
+  await("leveldbSetProfileAsync(db, 'interactive')");
+
+  EXPECT_EQ(error("leveldbSetProfileAsync(db, 'fast')"), "leveldbSetProfileAsync/invalid-params");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {profile: 'fast'})"), "leveldbOpen/invalid-options");
+}
+
+TEST_F(LeveldbTest, Comparators) {
+  eval("function keys(db) {"
+       "  var it = leveldbNewIterator(db), keys = [];"
+       "  for (leveldbIteratorSeekToFirst(it); leveldbIteratorValid(it); leveldbIteratorNext(it))"
+       "    keys.push(leveldbIteratorKeyStr(it));"
+       "  leveldbIteratorDelete(it);"
+       "  return keys;"
+       "}"
+       "var reverse = leveldbOpen('reverse.db', true, true, {comparator: 'reverse'});"
+       "['b', 'a', 'c', 'ab'].forEach(k => leveldbPut(reverse, k, 1));");
+  EXPECT_EQ(json("keys(reverse)"), "[\"c\",\"b\",\"ab\",\"a\"]");
+
+  // Big-endian int64 keys, with a one-byte suffix.
+  eval("function int64Key(hi, lo, suffix) {"
+       "  var view = new DataView(new ArrayBuffer(9));"
+       "  view.setInt32(0, hi); view.setUint32(4, lo); view.setUint8(8, suffix);"
+       "  return view.buffer;"
+       "}"
+       "var int64 = leveldbOpen('int64.db', true, true, {comparator: 'int64'});"
+       "[[0, 5, 1], [-1, 0, 0], [0, 5, 0], [1, 0, 0], [-2, 7, 0]].forEach(([hi, lo, suffix]) =>"
+       "  leveldbPut(int64, int64Key(hi, lo, suffix), hi * 4294967296 + lo + suffix / 10));"
+       "var values = [], it = leveldbNewIterator(int64);"
+       "for (leveldbIteratorSeekToFirst(it); leveldbIteratorValid(it); leveldbIteratorNext(it))"
+       "  values.push(leveldbGet(int64, leveldbIteratorKeyBuf(it)));"
+       "leveldbIteratorDelete(it);");
+  EXPECT_EQ(json("values"), json("[-2 * 4294967296 + 7, -4294967296, 5, 5.1, 4294967296]"));
+
+  // Ranges follow the DB's order.
+  await("leveldbExportAsync(reverse, dir + 'reverse.dump', 'b', 'a', false)");
+  eval("var imported = leveldbOpen('imported.db', true, true);");
+  await("leveldbImportAsync(imported, dir + 'reverse.dump', 1024)");
+  EXPECT_EQ(json("keys(imported)"), "[\"ab\",\"b\"]");
+
+  // LevelDB refuses to open a DB with another comparator than it was created with.
+  eval("leveldbClose(reverse);");
+  EXPECT_NE(error("leveldbOpen('reverse.db', false, false)"), "");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {comparator: 'random'})"), "leveldbOpen/invalid-options");
+}
+
+TEST_F(LeveldbTest, Close) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbClose(db);");
+  EXPECT_EQ(error("leveldbClose(db)"), "leveldbClose/db-idx-out-of-bounds");
+  EXPECT_EQ(error("leveldbClose('x')"), "leveldbClose/invalid-params");
+  // Reopens from disk.
+  eval("db = leveldbOpen('a.db', false, false);");
+  EXPECT_TRUE(eval("leveldbGet(db, 'k')").isNull());
+}
+
+TEST_F(LeveldbTest, Destroy) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1); leveldbClose(db); leveldbDestroy('a.db');");
+  EXPECT_NE(error("leveldbOpen('a.db', false, false)"), "");
+  EXPECT_EQ(error("leveldbDestroy(1)"), "leveldbDestroy/invalid-params");
+}
+
+TEST_F(LeveldbTest, PutGet) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "var value = {s: 'str', n: -1.5, i: 42, b: true, z: null, a: [1, 'two', {three: 3}], o: {nested: {deep: 'x'}}};"
+       "leveldbPut(db, 'k', value);");
+  EXPECT_EQ(json("leveldbGet(db, 'k')"), json("value"));
+  EXPECT_TRUE(eval("leveldbGet(db, 'missing')").isNull());
+
+  eval("leveldbPut(db, 'k', 'overwritten', true);");
+  EXPECT_EQ(str("leveldbGet(db, 'k')"), "overwritten");
+
+  // ArrayBuffer keys are their raw bytes.
+  eval("leveldbPut(db, new Uint8Array([104, 105]).buffer, 'hi');");
+  EXPECT_EQ(str("leveldbGet(db, 'hi')"), "hi");
+
+  EXPECT_EQ(error("leveldbPut(db, 1, 'v')"), "leveldbPut/invalid-params");
+  EXPECT_EQ(error("leveldbGet(db, 1)"), "leveldbGet/invalid-params");
+  EXPECT_EQ(error("leveldbPut(1000000, 'k', 'v')"), "leveldbPut/valueToDb/idx-out-of-range");
+  EXPECT_EQ(error("leveldbGet('db', 'k')"), "leveldbGet/valueToDb/param-not-a-number");
+}
+
+TEST_F(LeveldbTest, GetStr) {
+  // Values are stored msgpack-encoded: 1 is the single byte 0x01.
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1);");
+  EXPECT_EQ(str("leveldbGetStr(db, 'k')"), "\x01");
+  EXPECT_TRUE(eval("leveldbGetStr(db, 'missing')").isNull());
+  EXPECT_EQ(error("leveldbGetStr(db, 1)"), "leveldbGetStr/invalid-params");
+}
+
+TEST_F(LeveldbTest, GetAllStr) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'a', 1); leveldbPut(db, 'b', 2);");
+  EXPECT_EQ(json("leveldbGetAllStr(db)"), "{\"a\":\"\\u0001\",\"b\":\"\\u0002\"}");
+}
+
+TEST_F(LeveldbTest, Delete) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1); leveldbDelete(db, 'k');");
+  EXPECT_TRUE(eval("leveldbGet(db, 'k')").isNull());
+  // Deleting a missing key is fine.
+  eval("leveldbDelete(db, 'k', true);");
+  EXPECT_EQ(error("leveldbDelete(db, 1)"), "leveldbDelete/invalid-params");
+}
+
+TEST_F(LeveldbTest, BatchObjects) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'gone', 1);"
+       "leveldbBatchObjects(db, {a: {x: 1}, b: [2]}, ['gone']);");
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{\"a\":{\"x\":1},\"b\":[2]}");
+  eval("leveldbBatchObjects(db, {}, ['a', 'b'], true);");
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{}");
+}
+
+TEST_F(LeveldbTest, GetAllObjects) {
+  eval("var db = leveldbOpen('a.db', true, true);");
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{}");
+  eval("for (var i = 0; i < 100; i++) leveldbPut(db, 'k' + i, {i});");
+  EXPECT_EQ(num("Object.keys(leveldbGetAllObjects(db)).length"), 100);
+  EXPECT_EQ(num("leveldbGetAllObjects(db).k42.i"), 42);
+}
+
+TEST_F(LeveldbTest, Clear) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'a', 1); leveldbPut(db, 'b', 2); leveldbClear(db);");
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{}");
+}
+
+TEST_F(LeveldbTest, WriteCoalescing) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbSetWriteCoalescing(db, 1 << 20, 60 * 1000);"
+       "leveldbPut(db, 'a', 1); leveldbPut(db, 'b', 2); leveldbDelete(db, 'a');");
+  // Staged writes are visible to reads, and to iterators, which commit them first.
+  EXPECT_TRUE(eval("leveldbGet(db, 'a')").isNull());
+  EXPECT_EQ(num("leveldbGet(db, 'b')"), 2);
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{\"b\":2}");
+
+  eval("leveldbPut(db, 'c', 3); leveldbSetWriteCoalescing(db, 0, 0);");
+  EXPECT_EQ(num("leveldbGet(db, 'c')"), 3);
+  EXPECT_EQ(error("leveldbSetWriteCoalescing(db, -1, 0)"), "leveldbSetWriteCoalescing/invalid-params");
+}
+
+TEST_F(LeveldbTest, Flush) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbSetWriteCoalescing(db, 1 << 20, 60 * 1000);"
+       "leveldbPut(db, 'a', 1); leveldbFlush(db, true); leveldbClose(db);"
+       "db = leveldbOpen('a.db', false, false);");
+  EXPECT_EQ(num("leveldbGet(db, 'a')"), 1);
+  eval("leveldbFlush(db);");
+}
+
+TEST_F(LeveldbTest, Iterator) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'a', 1); leveldbPut(db, 'b', 2);"
+       "leveldbPut(db, 'c', 3); var it = leveldbNewIterator(db);");
+  EXPECT_FALSE(boolean("leveldbIteratorValid(it)"));
+
+  eval("leveldbIteratorSeekToFirst(it);");
+  EXPECT_TRUE(boolean("leveldbIteratorValid(it)"));
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "a");
+  EXPECT_EQ(str("leveldbIteratorValueStr(it)"), "\x01");
+
+  eval("leveldbIteratorNext(it);");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "b");
+
+  eval("leveldbIteratorSeekToLast(it);");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "c");
+  eval("leveldbIteratorPrev(it);");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "b");
+
+  eval("leveldbIteratorSeek(it, 'bb');");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "c");
+  eval("leveldbIteratorNext(it);");
+  EXPECT_FALSE(boolean("leveldbIteratorValid(it)"));
+
+  // Iterators see a snapshot of the DB as of their creation.
+  eval("leveldbPut(db, 'd', 4); leveldbIteratorSeekToLast(it);");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "c");
+
+  eval("leveldbIteratorDelete(it);");
+  EXPECT_EQ(error("leveldbIteratorValid(it)"), "leveldbIteratorValid/invalid-params");
+  EXPECT_EQ(error("leveldbIteratorNext(it)"), "leveldbIteratorNext/invalid-params");
+  EXPECT_EQ(error("leveldbIteratorSeek(it, 'a')"), "leveldbIteratorSeek/invalid-params");
+}
+
+TEST_F(LeveldbTest, IteratorOutlivesClose) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'a', 1);"
+       "var it = leveldbNewIterator(db); leveldbClose(db); leveldbIteratorSeekToFirst(it);");
+  EXPECT_EQ(str("leveldbIteratorKeyStr(it)"), "a");
+  eval("leveldbIteratorDelete(it);");
+}
+
+TEST_F(LeveldbTest, IteratorBuffers) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'key', 'v');"
+       "var it = leveldbNewIterator(db); leveldbIteratorSeekToFirst(it);");
+  EXPECT_EQ(json("Array.from(new Uint8Array(leveldbIteratorKeyBuf(it)))"), "[107,101,121]");
+  // msgpack fixstr of length 1.
+  EXPECT_EQ(json("Array.from(new Uint8Array(leveldbIteratorValueBuf(it)))"), "[161,118]");
+  eval("leveldbIteratorDelete(it);");
+  EXPECT_EQ(error("leveldbIteratorKeyBuf(it)"), "leveldbIteratorKeyBuf/invalid-params");
+  EXPECT_EQ(error("leveldbIteratorValueBuf(it)"), "leveldbIteratorValueBuf/invalid-params");
+}
+
+TEST_F(LeveldbTest, TestException) {
+  EXPECT_EQ(error("leveldbTestException()"), "leveldbTestException");
+}
+
+TEST_F(LeveldbTest, Merge) {
+  eval("var dst = leveldbOpen('dst.db', true, true); var src = leveldbOpen('src.db', true, true);"
+       "leveldbPut(dst, 'a', 'dst'); leveldbPut(dst, 'b', 'dst'); leveldbPut(src, 'b', 'src'); leveldbPut(src, 'c', 'src');"
+       "leveldbMerge(dst, src, true);");
+  EXPECT_EQ(json("leveldbGetAllObjects(dst)"), "{\"a\":\"dst\",\"b\":\"src\",\"c\":\"src\"}");
+  eval("leveldbPut(src, 'd', 'src'); leveldbMerge(dst, src, false);");
+  EXPECT_EQ(str("leveldbGet(dst, 'd')"), "src");
+  EXPECT_EQ(error("leveldbMerge(dst, src, 1)"), "leveldbMerge/batchMerge-param-not-a-boolean");
+}
+
+TEST_F(LeveldbTest, MergeAsync) {
+  eval("var dst = leveldbOpen('dst.db', true, true); var src = leveldbOpen('src.db', true, true);"
+       "for (var i = 0; i < 1000; i++) leveldbPut(src, 'k' + i, 'x'.repeat(100));"
+       "var progress = [];");
+  EXPECT_EQ(await("leveldbMergeAsync(dst, src, 4096, (entries, fraction) => progress.push([entries, fraction]))")
+                .asNumber(),
+            1000);
+  EXPECT_EQ(num("Object.keys(leveldbGetAllObjects(dst)).length"), 1000);
+  // Progress is reported after each chunk, and queued before the promise settles.
+  EXPECT_GT(num("progress.length"), 1);
+  EXPECT_EQ(num("progress[progress.length - 1][0]"), 1000);
+  EXPECT_EQ(error("leveldbMergeAsync(dst, src, 0)"), "leveldbMergeAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, ExportImport) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "for (var i = 0; i < 100; i++) leveldbPut(db, 'k' + String(i).padStart(3, '0'), {i});");
+  EXPECT_EQ(await("leveldbExportAsync(db, dir + 'all.dump', null, null, false)").asNumber(), 100);
+  EXPECT_EQ(await("leveldbExportAsync(db, dir + 'range.dump', 'k010', 'k020', true)").asNumber(), 10);
+
+  eval("var all = leveldbOpen('all.db', true, true); var range = leveldbOpen('range.db', true, true);");
+  EXPECT_EQ(await("leveldbImportAsync(all, dir + 'all.dump', 1024)").asNumber(), 100);
+  EXPECT_EQ(json("leveldbGetAllObjects(all)"), json("leveldbGetAllObjects(db)"));
+  EXPECT_EQ(await("leveldbImportAsync(range, dir + 'range.dump', 1 << 20)").asNumber(), 10);
+  EXPECT_EQ(num("leveldbGet(range, 'k015').i"), 15);
+  EXPECT_TRUE(eval("leveldbGet(range, 'k020')").isNull());
+
+  EXPECT_THROW(await("leveldbImportAsync(db, dir + 'missing.dump', 1024)"), jsi::JSError);
+  // Corrupt block sizes fail the import, rather than being allocated.
+  writeFile("stored.dump", std::string("RNLDBDMP\x01\x00", 10) + std::string(8, '\xff'));
+  writeFile("raw.dump", std::string("RNLDBDMP\x01\x01", 10) + std::string("\xff\xff\xff\xff\x04\0\0\0", 8) + "abcd");
+  EXPECT_THROW(await("leveldbImportAsync(db, dir + 'stored.dump', 1024)"), jsi::JSError);
+  EXPECT_THROW(await("leveldbImportAsync(db, dir + 'raw.dump', 1024)"), jsi::JSError);
+  EXPECT_EQ(error("leveldbImportAsync(db, dir + 'all.dump', 0)"), "leveldbImportAsync/invalid-params");
+  EXPECT_EQ(error("leveldbExportAsync(db, 1)"), "leveldbExportAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, ReadFileBuf) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1);");
+  await("leveldbExportAsync(db, dir + 'a.dump', null, null, false)");
+  // The dump file starts with its magic.
+  EXPECT_EQ(str("String.fromCharCode.apply(null, new Uint8Array(leveldbReadFileBuf(dir + 'a.dump', 0, 8)))"),
+            "RNLDBDMP");
+  EXPECT_EQ(num("leveldbReadFileBuf(dir + 'a.dump', 2, 3).byteLength"), 3);
+  EXPECT_EQ(error("leveldbReadFileBuf(dir + 'a.dump', 1e9, 1)"), "leveldbReadFileBuf/invalid-len-plus-pos");
+  EXPECT_EQ(error("leveldbReadFileBuf(dir + 'a.dump', -1, 1)"), "leveldbReadFileBuf/invalid-params");
+  EXPECT_NE(error("leveldbReadFileBuf(dir + 'missing', 0, 1)").find("open-error"), std::string::npos);
+}
+
+TEST_F(LeveldbTest, OpenFileReader) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1);");
+  await("leveldbExportAsync(db, dir + 'a.dump', null, null, false)");
+  eval("var reader = leveldbOpenFileReader(dir + 'a.dump');");
+  EXPECT_GT(num("reader.size"), 8);
+  EXPECT_EQ(json("Array.from(new Uint8Array(reader.read(0, 8)))"),
+            json("Array.from(new Uint8Array(leveldbReadFileBuf(dir + 'a.dump', 0, 8)))"));
+  EXPECT_NE(error("reader.read(reader.size, 1)"), "");
+  eval("reader.close();");
+  EXPECT_EQ(error("reader.size"), "leveldbFileReader/closed");
+  EXPECT_NE(error("leveldbOpenFileReader(dir + 'missing')"), "");
+}
+
+TEST_F(LeveldbTest, TupleKeys) {
+  eval("var buf = new Uint8Array([0, 1, 255]).buffer;"
+       "var roundTrip = (t) => leveldbDecodeKey(leveldbEncodeKey(t));"
+       "var lt = (a, b) => {"
+       "  var x = new Uint8Array(leveldbEncodeKey(a)), y = new Uint8Array(leveldbEncodeKey(b));"
+       "  for (var i = 0; i < Math.min(x.length, y.length); i++) if (x[i] != y[i]) return x[i] < y[i];"
+       "  return x.length < y.length;"
+       "};");
+  EXPECT_EQ(json("roundTrip(['a\\0b', '', 0, -1, 255, -70000, 2 ** 53 - 1, -(2 ** 53 - 1), 1.5, -0.25, true, false,"
+                 "  null, [null, 'x', []]])"),
+            "[\"a\\u0000b\",\"\",0,-1,255,-70000,9007199254740991,-9007199254740991,1.5,-0.25,true,false,null,"
+            "[null,\"x\",[]]]");
+  EXPECT_EQ(json("Array.from(new Uint8Array(roundTrip([buf])[0]))"), "[0,1,255]");
+
+  // Encoded keys sort like the tuples.
+  for (const char* pair : {"[-70000], [-1]", "[-1], [0]", "[0], [255]", "[255], [256]", "[256], [2 ** 40]",
+                           "[-1.5], [-0.25]", "[-0.25], [1.5]", "['a'], ['a\\0']", "['a\\0'], ['ab']",
+                           "['a'], ['a', 1]", "[['a']], [['a', null]]", "[null], ['']", "[false], [true]"}) {
+    EXPECT_TRUE(boolean(std::string("lt(") + pair + ")")) << pair;
+  }
+
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "leveldbPut(db, ['conv', 2, 10], 'c'); leveldbPut(db, ['conv', 1, 300], 'b');"
+       "leveldbPut(db, ['conv', 1, 20], 'a');");
+  EXPECT_EQ(str("leveldbGetStr(db, ['conv', 1, 300])"), "b");
+  EXPECT_EQ(str("leveldbGetStr(db, leveldbEncodeKey(['conv', 1, 300]))"), "b");
+  eval("leveldbDelete(db, ['conv', 1, 300]);");
+  EXPECT_TRUE(eval("leveldbGetStr(db, ['conv', 1, 300])").isNull());
+  eval("leveldbPut(db, ['conv', 1, 300], 'b');"
+       "var keys = [], it = leveldbNewIterator(db);"
+       "for (leveldbIteratorSeek(it, ['conv', 1]); leveldbIteratorValid(it); leveldbIteratorNext(it))"
+       "  keys.push(leveldbDecodeKey(leveldbIteratorKeyBuf(it)));"
+       "leveldbIteratorDelete(it);");
+  EXPECT_EQ(json("keys"), "[[\"conv\",1,20],[\"conv\",1,300],[\"conv\",2,10]]");
+
+  EXPECT_EQ(error("leveldbEncodeKey('a')"), "leveldbEncodeKey/invalid-params");
+  EXPECT_NE(error("leveldbEncodeKey([{}])"), "");
+  EXPECT_NE(error("leveldbEncodeKey([undefined])"), "");
+  EXPECT_NE(error("leveldbDecodeKey(new Uint8Array([0x02, 0x61]).buffer)"), "");
+  EXPECT_NE(error("leveldbDecodeKey(new Uint8Array([0x7f]).buffer)"), "");
+  EXPECT_EQ(error("leveldbDecodeKey(1)"), "leveldbDecodeKey/invalid-params");
+
+  // Tuples nest up to 32 deep, self-referencing arrays included.
+  EXPECT_EQ(num("var t = []; for (var i = 0; i < 32; i++) t = [t];"
+                "var depth = 0; for (var u = roundTrip(t); u.length; u = u[0]) depth++; depth"),
+            32);
+  EXPECT_EQ(error("t = [t]; leveldbEncodeKey(t)"),
+            "tuple/ maximum depth reached");
+  EXPECT_EQ(error("var a = []; a.push(a); leveldbEncodeKey([a])"), "tuple/ maximum depth reached");
+  EXPECT_EQ(error("leveldbDecodeKey(new Uint8Array(100).fill(0x05).buffer)"), "tuple/ maximum depth reached");
+}
+
+TEST_F(LeveldbTest, ScanPrefix) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "leveldbPut(db, 'a', 0); leveldbPut(db, 'b1', 1); leveldbPut(db, 'b2', {x: 2}); leveldbPut(db, 'b3', 3);"
+       "leveldbPut(db, 'c', 4);"
+       "leveldbPut(db, ['t', 1, 20], 'x'); leveldbPut(db, ['t', 1, 10], 'y'); leveldbPut(db, ['t', 2, 5], 'z');"
+       "leveldbPut(db, new Uint8Array([255, 255]).buffer, 5);");
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'b', Infinity, false, 'string')"),
+            "[[\"b1\",1],[\"b2\",{\"x\":2}],[\"b3\",3]]");
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'b', 2, true, 'string')"), "[[\"b3\",3],[\"b2\",{\"x\":2}]]");
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'b', 0, false, 'string')"), "[]");
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'bb', Infinity, false, 'string')"), "[]");
+  EXPECT_EQ(num("leveldbScanPrefix(db, 'b1', Infinity, false, 'buffer')[0][0].byteLength"), 2);
+  EXPECT_EQ(json("leveldbScanPrefix(db, ['t', 1], Infinity, false, 'tuple')"),
+            "[[[\"t\",1,10],\"y\"],[[\"t\",1,20],\"x\"]]");
+  EXPECT_EQ(json("leveldbScanPrefix(db, ['t', 1], 1, true, 'tuple')"), "[[[\"t\",1,20],\"x\"]]");
+  // A prefix without a successor scans to the end.
+  EXPECT_EQ(num("leveldbScanPrefix(db, new Uint8Array([255]).buffer, Infinity, true, 'buffer').length"), 1);
+  // The empty prefix matches everything.
+  EXPECT_EQ(num("leveldbScanPrefix(db, '', Infinity, true, 'buffer').length"), 9);
+
+  EXPECT_EQ(error("leveldbScanPrefix(db, 'b', -1, false, 'string')"), "leveldbScanPrefix/invalid-params");
+  EXPECT_EQ(error("leveldbScanPrefix(db, 'b', 1, false, 'json')"), "leveldbScanPrefix/invalid-params");
+  eval("var rev = leveldbOpen('rev.db', true, true, {comparator: 'reverse'});");
+  EXPECT_EQ(error("leveldbScanPrefix(rev, 'b', 1, false, 'string')"), "leveldbScanPrefix/unsupported-comparator");
+}
+
+TEST_F(LeveldbTest, Ttl) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "leveldbPut(db, 'kept', 1); leveldbPut(db, 'fresh', 2, false, 3600000); leveldbPut(db, 'stale', 3, false, 1);"
+       "leveldbBatchObjects(db, {b1: 4, b2: 5}, [], false, 1); leveldbBatchObjects(db, {b3: 6}, [], false, 3600000);");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  EXPECT_EQ(num("leveldbGet(db, 'kept')"), 1);
+  EXPECT_EQ(num("leveldbGet(db, 'fresh')"), 2);
+  EXPECT_TRUE(eval("leveldbGet(db, 'stale')").isNull());
+  EXPECT_TRUE(eval("leveldbGet(db, 'b1')").isNull());
+  EXPECT_EQ(json("leveldbGetAllObjects(db)"), "{\"b3\":6,\"fresh\":2,\"kept\":1}");
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'b', Infinity, false, 'string')"), "[[\"b3\",6]]");
+  // Expiring values start with their header.
+  eval("var it = leveldbNewIterator(db); leveldbIteratorSeek(it, 'fresh');"
+       "var header = Array.from(new Uint8Array(leveldbIteratorValueBuf(it))).slice(0, 2); leveldbIteratorDelete(it);");
+  EXPECT_EQ(json("header"), "[193,1]");
+
+  EXPECT_EQ(await("leveldbSweepExpiredAsync(db, 1)").asNumber(), 3);
+  EXPECT_EQ(await("leveldbSweepExpiredAsync(db, 1)").asNumber(), 0);
+  eval("var keys = [], it = leveldbNewIterator(db);"
+       "for (leveldbIteratorSeekToFirst(it); leveldbIteratorValid(it); leveldbIteratorNext(it))"
+       "  keys.push(leveldbIteratorKeyStr(it));"
+       "leveldbIteratorDelete(it);");
+  EXPECT_EQ(json("keys"), "[\"b3\",\"fresh\",\"kept\"]");
+
+  // Rewriting an expired value makes it live again.
+  eval("leveldbPut(db, 'stale', 7, false, 1);");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  eval("leveldbPut(db, 'stale', 8);");
+  EXPECT_EQ(await("leveldbSweepExpiredAsync(db, 1024)").asNumber(), 0);
+  EXPECT_EQ(num("leveldbGet(db, 'stale')"), 8);
+
+  EXPECT_EQ(error("leveldbPut(db, 'k', 1, false, 0)"), "leveldbPut/invalid-params");
+  EXPECT_EQ(error("leveldbPut(db, 'k', 1, false, '1')"), "leveldbPut/invalid-params");
+  EXPECT_EQ(error("leveldbBatchObjects(db, {k: 1}, [], false, -1)"), "leveldbBatchObjects/invalid-params");
+  EXPECT_EQ(error("leveldbSweepExpiredAsync(db, 0)"), "leveldbSweepExpiredAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, Update) {
+  eval("var db = leveldbOpen('a.db', true, true);");
+  EXPECT_EQ(num("leveldbUpdate(db, 'n', {inc: 2})"), 2);
+  EXPECT_EQ(num("leveldbUpdate(db, 'n', {inc: -5})"), -3);
+  EXPECT_EQ(num("leveldbGet(db, 'n')"), -3);
+  EXPECT_EQ(json("leveldbUpdate(db, 'l', {push: 'a'})"), "[\"a\"]");
+  EXPECT_EQ(json("leveldbUpdate(db, 'l', {push: {b: 1}})"), "[\"a\",{\"b\":1}]");
+  EXPECT_EQ(json("leveldbGet(db, 'l')"), "[\"a\",{\"b\":1}]");
+  EXPECT_EQ(json("leveldbUpdate(db, 'o', {merge: {a: 1, b: 2}})"), "{\"a\":1,\"b\":2}");
+  EXPECT_EQ(json("leveldbUpdate(db, 'o', {merge: {b: 3, c: [4]}})"), "{\"a\":1,\"b\":3,\"c\":[4]}");
+  EXPECT_EQ(json("leveldbUpdate(db, ['t', 1], {set: 'x'})"), "\"x\"");
+  EXPECT_EQ(str("leveldbGet(db, ['t', 1])"), "x");
+
+  // The TTL is kept.
+  eval("leveldbPut(db, 'c', 1, false, 3600000); leveldbUpdate(db, 'c', {inc: 1});"
+       "var it = leveldbNewIterator(db); leveldbIteratorSeek(it, 'c');"
+       "var header = new Uint8Array(leveldbIteratorValueBuf(it))[0]; leveldbIteratorDelete(it);");
+  EXPECT_EQ(num("header"), 0xc1);
+  EXPECT_EQ(num("leveldbGet(db, 'c')"), 2);
+
+  // Works on staged writes too.
+  eval("leveldbSetWriteCoalescing(db, 1 << 20, 1000); leveldbPut(db, 'n', 10);");
+  EXPECT_EQ(num("leveldbUpdate(db, 'n', {inc: 1})"), 11);
+  eval("leveldbFlush(db);");
+  EXPECT_EQ(num("leveldbGet(db, 'n')"), 11);
+
+  // The operand is read before other writes are held off, so reading it may write to the DB.
+  EXPECT_EQ(json("leveldbUpdate(db, 'o', {merge: {get d() { leveldbPut(db, 'side', 1); return 5; }}})"),
+            "{\"a\":1,\"b\":3,\"c\":[4],\"d\":5}");
+  EXPECT_EQ(num("leveldbGet(db, 'side')"), 1);
+
+  EXPECT_EQ(error("leveldbUpdate(db, 'l', {inc: 1})"), "leveldbUpdate/not-a-number");
+  EXPECT_EQ(error("leveldbUpdate(db, 'n', {push: 1})"), "leveldbUpdate/not-an-array");
+  EXPECT_EQ(error("leveldbUpdate(db, 'l', {merge: {}})"), "leveldbUpdate/not-an-object");
+  EXPECT_EQ(num("leveldbGet(db, 'n')"), 11);
+  EXPECT_EQ(error("leveldbUpdate(db, 'n', {})"), "leveldbUpdate/invalid-params");
+  EXPECT_EQ(error("leveldbUpdate(db, 'n', {inc: 1, set: 2})"), "leveldbUpdate/invalid-params");
+  EXPECT_EQ(error("leveldbUpdate(db, 'n', {inc: '1'})"), "leveldbUpdate/invalid-params");
+  EXPECT_EQ(error("leveldbUpdate(db, 'n', {merge: [1]})"), "leveldbUpdate/invalid-params");
+}
+
+TEST_F(LeveldbTest, Cas) {
+  eval("var db = leveldbOpen('a.db', true, true);");
+  EXPECT_TRUE(boolean("leveldbCas(db, 'k', undefined, {v: 1})"));
+  EXPECT_FALSE(boolean("leveldbCas(db, 'k', undefined, {v: 2})"));
+  EXPECT_FALSE(boolean("leveldbCas(db, 'k', {v: 2}, {v: 3})"));
+  EXPECT_EQ(num("leveldbGet(db, 'k').v"), 1);
+  EXPECT_TRUE(boolean("leveldbCas(db, 'k', {v: 1}, {v: 3})"));
+  EXPECT_EQ(num("leveldbGet(db, 'k').v"), 3);
+  EXPECT_FALSE(boolean("leveldbCas(db, 'k', {v: 1}, undefined)"));
+  EXPECT_TRUE(boolean("leveldbCas(db, 'k', {v: 3}, undefined)"));
+  EXPECT_TRUE(eval("leveldbGet(db, 'k')").isNull());
+  EXPECT_TRUE(boolean("leveldbCas(db, 'k', undefined, null)"));
+  EXPECT_TRUE(eval("leveldbGet(db, 'k')").isNull());
+  EXPECT_FALSE(boolean("leveldbCas(db, 'k', undefined, 1)"));
+  EXPECT_TRUE(boolean("leveldbCas(db, 'k', null, 1)"));
+
+  // Expired values count as missing.
+  eval("leveldbPut(db, 'e', 1, false, 1);");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_FALSE(boolean("leveldbCas(db, 'e', 1, 2)"));
+  EXPECT_TRUE(boolean("leveldbCas(db, 'e', undefined, 2)"));
+  EXPECT_EQ(num("leveldbGet(db, 'e')"), 2);
+
+  EXPECT_EQ(error("leveldbCas(db, 'k', 1)"), "leveldbCas/invalid-params");
+}
+
+TEST_F(LeveldbTest, Watch) {
+  eval("var db = leveldbOpen('a.db', true, true); var all = [], range = [], tuples = [];"
+       "var allId = leveldbWatch(db, null, null, 'string', (keys) => all.push(keys));"
+       "leveldbWatch(db, 'b', 'c', 'string', (keys) => range.push(keys));"
+       "leveldbWatch(db, ['t'], ['u'], 'tuple', (keys) => tuples.push(keys));");
+
+  // Changes are coalesced until the JS thread gets to them.
+  eval("leveldbPut(db, 'a', 1); leveldbPut(db, 'b1', 1); leveldbPut(db, 'b1', 2); leveldbDelete(db, 'b2');"
+       "leveldbBatchObjects(db, {b3: 1, c: 1}, ['a']); leveldbPut(db, ['t', 1], 1);");
+  EXPECT_EQ(json("all"), "[]");
+  host.invoker().drain();
+  EXPECT_EQ(num("all.length"), 1);
+  EXPECT_EQ(json("all[0].slice(0, 5)"), "[\"a\",\"b1\",\"b2\",\"b3\",\"c\"]");
+  EXPECT_EQ(json("range"), "[[\"b1\",\"b2\",\"b3\"]]");
+  EXPECT_EQ(json("tuples"), "[[[\"t\",1]]]");
+
+  eval("leveldbUpdate(db, 'b4', {inc: 1}); leveldbClear(db);");
+  host.invoker().drain();
+  EXPECT_EQ(num("range.length"), 2);
+  EXPECT_EQ(json("range[1]"), "[\"b4\",\"b1\",\"b3\"]");
+
+  // Staged writes are published too.
+  eval("leveldbSetWriteCoalescing(db, 1 << 20, 1000); leveldbPut(db, 'b5', 1);");
+  host.invoker().drain();
+  EXPECT_EQ(json("range[2]"), "[\"b5\"]");
+
+  EXPECT_TRUE(boolean("leveldbUnwatch(db, allId)"));
+  EXPECT_FALSE(boolean("leveldbUnwatch(db, allId)"));
+  eval("leveldbPut(db, 'b6', 1);");
+  host.invoker().drain();
+  EXPECT_EQ(num("all.length"), 3);
+  EXPECT_EQ(num("range.length"), 4);
+
+  EXPECT_EQ(error("leveldbWatch(db, null, null, 'string')"), "leveldbWatch/invalid-params");
+  EXPECT_EQ(error("leveldbWatch(db, 1, null, 'string', () => {})"), "leveldbWatch/invalid-params");
+  EXPECT_EQ(error("leveldbWatch(db, null, null, 'json', () => {})"), "leveldbWatch/invalid-params");
+
+  // Closing the DB drops the runtime's watches, even while it stays open for others.
+  eval("var other = leveldbOpen('a.db', false, false); var rangeId = leveldbWatch(db, 'b', 'c', 'string', () => {});"
+       "leveldbClose(db);");
+  EXPECT_FALSE(boolean("leveldbUnwatch(other, rangeId)"));
+  eval("leveldbPut(other, 'b7', 1);");
+  host.invoker().drain();
+  EXPECT_EQ(num("range.length"), 4);
+  eval("leveldbClose(other);");
+  EXPECT_FALSE(boolean("leveldbUnwatch(other, rangeId)"));
+}
+
+TEST_F(LeveldbTest, WriteBatch) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "leveldbPut(db, 'a1', 1); leveldbPut(db, 'a2', 2); leveldbPut(db, 'b', 3); leveldbPut(db, 'c', 4);"
+       "var batch = leveldbNewWriteBatch();"
+       "batch.put('x', {v: 1}).putRaw(new Uint8Array([0, 1]).buffer, 'raw').put(['t', 1], 'tuple')"
+       "  .put('a3', 3).deleteRange('a', 'b').put('a4', 4).delete('c');");
+  EXPECT_GT(num("batch.approximateSize()"), 0);
+  // Nothing is written until the batch is committed.
+  EXPECT_TRUE(eval("leveldbGet(db, 'x')").isNull());
+  eval("leveldbWrite(db, batch);");
+  EXPECT_EQ(num("leveldbGet(db, 'x').v"), 1);
+  EXPECT_EQ(str("leveldbGetStr(db, new Uint8Array([0, 1]).buffer)"), "raw");
+  EXPECT_EQ(str("leveldbGet(db, ['t', 1])"), "tuple");
+  // The range delete took the keys put before it in the batch, but not the ones after it.
+  EXPECT_EQ(json("leveldbScanPrefix(db, 'a', Infinity, false, 'string')"), "[[\"a4\",4]]");
+  EXPECT_EQ(num("leveldbGet(db, 'b')"), 3);
+  EXPECT_TRUE(eval("leveldbGet(db, 'c')").isNull());
+
+  // The batch can be cleared and reused.
+  eval("batch.clear().put('y', 1, {ttlMs: 3600000}); leveldbWrite(db, batch, true);");
+  EXPECT_EQ(num("leveldbGet(db, 'y')"), 1);
+  EXPECT_EQ(num("leveldbGet(db, 'x').v"), 1);
+
+  EXPECT_EQ(error("batch.put()"), "leveldbWriteBatch/invalid-params");
+  EXPECT_EQ(error("batch.putRaw('k', {})"), "leveldbWriteBatch/invalid-params");
+  EXPECT_EQ(error("batch.putRaw('k', ['t'])"), "leveldbWriteBatch/invalid-params");
+  // 0xc1 starts TTL headers, not raw values.
+  EXPECT_EQ(error("batch.putRaw('k', new Uint8Array([0xc1, 1, 0, 0, 0, 0, 0, 0, 0, 0]).buffer)"),
+            "leveldbWriteBatch/reserved-raw-value");
+  EXPECT_EQ(error("batch.deleteRange('a')"), "leveldbWriteBatch/invalid-params");
+  EXPECT_EQ(error("batch.put('k', 1, {ttlMs: -1})"), "leveldbWriteBatch/invalid-params");
+  EXPECT_EQ(error("leveldbWrite(db, {})"), "leveldbWrite/invalid-params");
+}
+
+TEST_F(LeveldbTest, PutMany) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "leveldbPutMany(db, ['a', ['t', 1], new Uint8Array([1]).buffer], [{x: 1}, 'two', [3]]);"
+       "leveldbPutMany(db, ['n1', 'n2', 'n3'], new Float64Array([1.5, -2, 1e300]));"
+       "var raw = new Uint8Array([97, 98, 99, 100, 101, 102]);"
+       "leveldbPutMany(db, ['r1', 'r2', 'r3'], raw, new Uint32Array([0, 1, 1, 6]));");
+  EXPECT_EQ(num("leveldbGet(db, 'a').x"), 1);
+  EXPECT_EQ(str("leveldbGet(db, ['t', 1])"), "two");
+  EXPECT_EQ(json("leveldbGet(db, new Uint8Array([1]).buffer)"), "[3]");
+  EXPECT_EQ(json("[leveldbGet(db, 'n1'), leveldbGet(db, 'n2'), leveldbGet(db, 'n3')]"), "[1.5,-2,1e+300]");
+  EXPECT_EQ(json("[leveldbGetStr(db, 'r1'), leveldbGetStr(db, 'r2'), leveldbGetStr(db, 'r3')]"),
+            "[\"a\",\"\",\"bcdef\"]");
+  // A view into a larger buffer.
+  eval("leveldbPutMany(db, ['v'], new Float64Array([1, 2, 3]).subarray(2));");
+  EXPECT_EQ(num("leveldbGet(db, 'v')"), 3);
+  eval("leveldbPutMany(db, ['e'], [1], undefined, false, 1);");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(eval("leveldbGet(db, 'e')").isNull());
+
+  EXPECT_EQ(error("leveldbPutMany(db, ['a', 'b'], [1])"), "leveldbPutMany/invalid-params");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a', 'b'], new Float64Array(1))"), "leveldbPutMany/invalid-params");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a'], new Uint8Array(1))"), "leveldbPutMany/invalid-params");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a'], new Uint8Array(1), new Uint32Array([0, 2]))"),
+            "leveldbPutMany/invalid-offsets");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a'], new Uint8Array([0xc1, 1]), new Uint32Array([0, 2]))"),
+            "leveldbPutMany/reserved-raw-value");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a'], new Uint8Array(1), new Uint32Array([0, 1]), false, 1000)"),
+            "leveldbPutMany/invalid-params");
+  EXPECT_EQ(error("leveldbPutMany(db, ['a'], new Int32Array(1))"), "leveldbPutMany/invalid-params");
+  EXPECT_EQ(error("leveldbPutMany(db, [{}], [1])"), "leveldbPutMany/invalid-params");
+  EXPECT_TRUE(eval("leveldbGet(db, 'b')").isNull());
+}
+
+TEST_F(LeveldbTest, BatchObjectsAsync) {
+  eval("function entries(db) {"
+       "  var it = leveldbNewIterator(db), entries = [];"
+       "  for (leveldbIteratorSeekToFirst(it); leveldbIteratorValid(it); leveldbIteratorNext(it))"
+       "    entries.push([leveldbIteratorKeyStr(it), Array.from(new Uint8Array(leveldbIteratorValueBuf(it)))]);"
+       "  leveldbIteratorDelete(it);"
+       "  return entries;"
+       "}"
+       "var record = {nested: {a: [1, 'two', null, undefined, {b: true}], c: -1.5}, nil: null, undef: undefined};"
+       "for (var i = 0; i < 1000; i++) record['k' + i] = {i: i, s: 'v' + i, big: i * 4294967296};"
+       "var sync = leveldbOpen('sync.db', true, true), async = leveldbOpen('async.db', true, true);"
+       "leveldbBatchObjects(sync, record, []);");
+  // Spans several encoding chunks, and encodes exactly like batchObjects().
+  await("leveldbBatchObjectsAsync(async, record, [])");
+  EXPECT_EQ(num("entries(async).length"), 1003);
+  EXPECT_EQ(json("entries(async)"), json("entries(sync)"));
+  EXPECT_EQ(json("leveldbGet(async, 'nested')"), "{\"a\":[1,\"two\",null,null,{\"b\":true}],\"c\":-1.5}");
+
+  await("leveldbBatchObjectsAsync(async, {k0: 'new', e: 1}, ['k1', 'k2'], false, 1)");
+  EXPECT_EQ(str("leveldbGet(async, 'k0')"), "new");
+  EXPECT_TRUE(eval("leveldbGet(async, 'k1')").isNull());
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  EXPECT_TRUE(eval("leveldbGet(async, 'e')").isNull());
+
+  // Values that can't be stored throw before anything is written.
+  EXPECT_EQ(error("leveldbBatchObjectsAsync(async, {k3: 1, f: () => 1}, [])"), "pack/ functions are not supported");
+  EXPECT_EQ(error("leveldbBatchObjectsAsync(async, {k3: 1, s: Symbol()}, [])"), "pack/ symbols are not supported");
+  EXPECT_EQ(num("leveldbGet(async, 'k3').i"), 3);
+  EXPECT_EQ(error("leveldbBatchObjectsAsync(async, {}, 'k3')"), "leveldbBatchObjectsAsync/invalid-params");
+  EXPECT_EQ(error("leveldbBatchObjectsAsync(async, {}, [{}])"), "leveldbBatchObjectsAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, GetAllObjectsAsync) {
+  eval("var db = leveldbOpen('a.db', true, true), record = {"
+       "  nested: {a: [1, 'two', null, undefined, {b: true}], c: -1.5}, nil: null, undef: undefined, s: 'caf\\u00e9'};"
+       "for (var i = 0; i < 1000; i++) record['k' + String(i).padStart(4, '0')] = {i: i, s: 'v' + i};"
+       "leveldbBatchObjects(db, record, []); leveldbPut(db, 'e', 1, false, 1);");
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  // Decodes exactly like getAllObjects(), across several chunks, and skips expired values.
+  jsi::Value all = await("leveldbGetAllObjectsAsync(db)");
+  host.runtime().global().setProperty(host.runtime(), "all", all);
+  EXPECT_EQ(json("all"), json("leveldbGetAllObjects(db)"));
+  EXPECT_EQ(num("Object.keys(all).length"), 1004);
+  EXPECT_TRUE(boolean("'undef' in all && all.undef === undefined && all.nested.a[3] === undefined"));
+  EXPECT_EQ(str("all.s"), "caf\u00e9");
+
+  host.runtime().global().setProperty(host.runtime(), "range", await("leveldbGetAllObjectsAsync(db, 'k0998', 'l')"));
+  EXPECT_EQ(json("range"), "{\"k0998\":{\"i\":998,\"s\":\"v998\"},\"k0999\":{\"i\":999,\"s\":\"v999\"}}");
+
+  eval("var batch = leveldbNewWriteBatch(); batch.putRaw('bad', new Uint8Array([0xd9]).buffer);"
+       "leveldbWrite(db, batch);");
+  EXPECT_THROW(await("leveldbGetAllObjectsAsync(db)"), jsi::JSError);
+  EXPECT_EQ(error("leveldbGetAllObjectsAsync(db, {})"), "leveldbGetAllObjectsAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, Warmup) {
+  eval("var db = leveldbOpen('a.db', true, true, {recordWarmupMs: 100});"
+       "leveldbPut(db, 'a', 1); leveldbPut(db, 'b', 2);"
+       "leveldbGet(db, 'a'); leveldbGet(db, 'missing'); leveldbGet(db, 'a');"
+       "leveldbScanPrefix(db, 'b', 10, false, 'string');");
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  eval("leveldbGet(db, 'b');");
+  // The reads of the first 100ms, without duplicates: two get()s, and the range of the scan.
+  eval("function sidecar() {"
+       "  var reader = leveldbOpenFileReader(dir + 'a.db.warmup');"
+       "  return Array.from(new Uint8Array(reader.read(0, reader.size)));"
+       "}");
+  EXPECT_EQ(json("sidecar()"), "[1,3,1,97,3,7,109,105,115,115,105,110,103,6,1,98,1,99]");
+
+  // Replayed on the next open, along with the prefetch ranges, and replaced by what that open reads. Closing before
+  // anything is read keeps the last recording.
+  eval("leveldbClose(db);"
+       "db = leveldbOpen('a.db', false, false, {recordWarmupMs: 100, prefetch: [{gte: 'a', lt: ['t']}, {}]});");
+  EXPECT_EQ(num("leveldbGet(db, 'b')"), 2);
+  eval("leveldbClose(db);");
+  EXPECT_EQ(json("sidecar()"), "[1,3,1,98]");
+  eval("db = leveldbOpen('a.db', false, false, {recordWarmupMs: 100, prefetchBytes: 0}); leveldbClose(db);");
+  EXPECT_EQ(json("sidecar()"), "[1,3,1,98]");
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  eval("leveldbDestroy('a.db');");
+  EXPECT_NE(error("sidecar()"), "");
+
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {prefetch: 'a'})"), "leveldbOpen/invalid-options");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {prefetch: [{gte: {}}]})"), "leveldbOpen/invalid-options");
+  EXPECT_EQ(error("leveldbOpen('b.db', true, true, {recordWarmupMs: -1})"), "leveldbOpen/invalid-options");
+}
+
+TEST_F(LeveldbTest, OpenAsync) {
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'k', 1); leveldbClose(db);"
+       "var opens = [leveldbOpenAsync('a.db', false, false), leveldbOpenAsync('a.db', false, false)];");
+  // Concurrent opens of a path share its handle, whether they're async or not.
+  double first = await("opens[0]").asNumber();
+  EXPECT_EQ(await("opens[1]").asNumber(), first);
+  EXPECT_EQ(num("leveldbOpen('a.db', false, false)"), first);
+  eval("db = " + std::to_string((int)first) + ";");
+  EXPECT_EQ(num("leveldbGet(db, 'k')"), 1);
+  eval("leveldbClose(db); leveldbClose(db);");
+  EXPECT_EQ(num("leveldbGet(db, 'k')"), 1);
+  eval("leveldbClose(db);");
+  EXPECT_NE(error("leveldbGet(db, 'k')").find("db-closed"), std::string::npos);
+
+  EXPECT_THROW(await("leveldbOpenAsync('missing.db', false, false)"), jsi::JSError);
+  eval("db = leveldbOpen('a.db', false, false);");
+  EXPECT_THROW(await("leveldbOpenAsync('a.db', true, true)"), jsi::JSError);
+  EXPECT_EQ(error("leveldbOpenAsync(1, true, true)"), "leveldbOpenAsync/invalid-params");
+  EXPECT_EQ(error("leveldbOpenAsync('b.db', true, true, {blockSize: 0})"), "leveldbOpenAsync/invalid-options");
+}
+
+TEST_F(LeveldbTest, ReadOnly) {
+  auto checkpoints = [&]() {
+    int count = 0;
+    DIR* dir = opendir(host.documentDir().c_str());
+    while (struct dirent* entry = readdir(dir)) {
+      count += std::string(entry->d_name).find("a.db.readonly-") == 0;
+    }
+    closedir(dir);
+    return count;
+  };
+  eval("var db = leveldbOpen('a.db', true, true); leveldbPut(db, 'a', 1);"
+       "var ro = leveldbOpen('a.db', false, false, {readOnly: true});");
+  // Not shared with the DB, which is open and locked.
+  EXPECT_NE(num("ro"), num("db"));
+  EXPECT_EQ(num("leveldbGet(ro, 'a')"), 1);
+  // Reads see the DB as of the open.
+  eval("leveldbPut(db, 'b', 2);");
+  EXPECT_TRUE(eval("leveldbGet(ro, 'b')").isNull());
+  EXPECT_NE(error("leveldbPut(ro, 'c', 3)").find("read-only"), std::string::npos);
+  EXPECT_NE(error("leveldbBatchObjects(ro, {c: 3}, [])").find("read-only"), std::string::npos);
+
+  eval("var ro2 = " + std::to_string((int)await("leveldbOpenAsync('a.db', false, false, {readOnly: true})").asNumber()));
+  EXPECT_EQ(num("leveldbGet(ro2, 'b')"), 2);
+  EXPECT_EQ(checkpoints(), 2);
+  // Each checkpoint is removed once its DB closes, even with an iterator still open on it.
+  eval("var it = leveldbNewIterator(ro); leveldbClose(ro); leveldbClose(ro2);");
+  EXPECT_EQ(checkpoints(), 1);
+  eval("leveldbIteratorDelete(it);");
+  EXPECT_EQ(checkpoints(), 0);
+  EXPECT_EQ(num("leveldbGet(db, 'b')"), 2);
+
+  EXPECT_NE(error("leveldbOpen('missing.db', false, false, {readOnly: true})"), "");
+}
+
+TEST_F(LeveldbTest, Checkpoint) {
+  eval("var db = leveldbOpen('a.db', true, true);"
+       "for (var i = 0; i < 1000; i++) leveldbPut(db, 'k' + i, 'x'.repeat(100));"
+       "leveldbSetWriteCoalescing(db, 1 << 20, 60000); leveldbPut(db, 'staged', 1);");
+  await("leveldbCheckpointAsync(db, 'backup.db')");
+  eval("leveldbPut(db, 'after', 1); var backup = leveldbOpen('backup.db', false, false);");
+  // Holds the writes made before the call, staged ones included, and is a DB of its own.
+  EXPECT_EQ(num("leveldbGet(backup, 'staged')"), 1);
+  EXPECT_EQ(str("leveldbGet(backup, 'k999')").size(), 100u);
+  EXPECT_TRUE(eval("leveldbGet(backup, 'after')").isNull());
+  eval("leveldbPut(backup, 'k0', 'changed');");
+  EXPECT_EQ(str("leveldbGet(db, 'k0')").size(), 100u);
+
+  // An existing DB is left alone.
+  EXPECT_THROW(await("leveldbCheckpointAsync(db, 'backup.db')"), jsi::JSError);
+  EXPECT_EQ(num("leveldbGet(backup, 'staged')"), 1);
+  EXPECT_EQ(error("leveldbCheckpointAsync(db, 1)"), "leveldbCheckpointAsync/invalid-params");
+}
+
+TEST_F(LeveldbTest, Blobs) {
+  auto blobFiles = [&](const std::string& db) {
+    int count = 0;
+    DIR* dir = opendir((host.documentDir() + "/" + db).c_str());
+    if (!dir) {
+      return -1;
+    }
+    while (struct dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      count += name.size() > 5 && name.compare(name.size() - 5, 5, ".blob") == 0;
+    }
+    closedir(dir);
+    return count;
+  };
+  eval("var db = leveldbOpen('a.db', true, true, {blobThreshold: 1000}); var big = 'x'.repeat(5000);"
+       "leveldbPut(db, 'big', big); leveldbPut(db, 'dead', big + big); leveldbPut(db, 'small', 1);");
+  EXPECT_EQ(blobFiles("a.db"), 1);
+  // Reads return the values pointed to, whichever way they read.
+  EXPECT_EQ(str("leveldbGet(db, 'big')"), std::string(5000, 'x'));
+  EXPECT_EQ(num("leveldbGet(db, 'small')"), 1);
+  EXPECT_EQ(num("leveldbScanPrefix(db, 'd', 10, false, 'string')[0][1].length"), 10000);
+  EXPECT_EQ(json("Object.keys(leveldbGetAllObjects(db))"), "[\"big\",\"dead\",\"small\"]");
+  eval("var it = leveldbNewIterator(db); leveldbIteratorSeek(it, 'big');");
+  EXPECT_GT(num("leveldbIteratorValueBuf(it).byteLength"), 5000);
+  eval("leveldbIteratorDelete(it);");
+  // A value that looks like a pointer goes to the blob file too, and reads back as it was written. Raw writes can't
+  // start with 0xc1, but imports can, e.g. of dumps of DBs written by older versions.
+  std::string dump = std::string("RNLDBDMP\x01\x00", 10) + std::string("\x1c\0\0\0\x1c\0\0\0\x04", 9) + "fake" +
+                     std::string("\x16\xc1\x02", 3) + std::string(20, '\0');
+  // The trailer: an empty block, then the number of entries.
+  dump += std::string("\0\0\0\0\x08\0\0\0\x01\0\0\0\0\0\0\0", 16);
+  writeFile("fake.dump", dump);
+  await("leveldbImportAsync(db, dir + 'fake.dump', 1 << 20)");
+  eval("var fake = new Uint8Array(22); fake[0] = 0xc1; fake[1] = 2;"
+       "it = leveldbNewIterator(db); leveldbIteratorSeek(it, 'fake');");
+  EXPECT_EQ(json("Array.from(new Uint8Array(leveldbIteratorValueBuf(it)))"), json("Array.from(fake)"));
+  eval("leveldbIteratorDelete(it);");
+
+  // The file is mostly garbage once 'dead' is deleted: 'big' and 'fake' move to a new file, and the old one goes.
+  eval("leveldbDelete(db, 'dead');");
+  EXPECT_GT(await("leveldbCollectBlobGarbageAsync(db, 0.5)").asNumber(), 10000);
+  EXPECT_EQ(blobFiles("a.db"), 1);
+  EXPECT_EQ(str("leveldbGet(db, 'big')").size(), 5000u);
+  // Nothing left to collect.
+  EXPECT_EQ(await("leveldbCollectBlobGarbageAsync(db, 0.5)").asNumber(), 0);
+  EXPECT_EQ(error("leveldbCollectBlobGarbageAsync(db, 2)"), "leveldbCollectBlobGarbageAsync/invalid-params");
+
+  // Values in blob files are read without the option too, which no longer separates new ones.
+  eval("leveldbClose(db); db = leveldbOpen('a.db', false, false); leveldbPut(db, 'big2', big);");
+  EXPECT_EQ(str("leveldbGet(db, 'big')").size(), 5000u);
+  EXPECT_EQ(blobFiles("a.db"), 1);
+
+  // A file that an open iterator may read is only removed once the iterator is gone.
+  eval("it = leveldbNewIterator(db); leveldbDelete(db, 'big'); leveldbDelete(db, 'fake');");
+  await("leveldbCollectBlobGarbageAsync(db, 0.5)");
+  EXPECT_EQ(blobFiles("a.db"), 1);
+  eval("leveldbIteratorSeek(it, 'big');");
+  EXPECT_GT(num("leveldbIteratorValueBuf(it).byteLength"), 5000);
+  eval("leveldbIteratorDelete(it);");
+  await("leveldbCollectBlobGarbageAsync(db, 0.5)");
+  EXPECT_EQ(blobFiles("a.db"), 0);
+
+  // Without the option too, a value that looks like a pointer goes to a blob file, and reads back as it was written.
+  await("leveldbImportAsync(db, dir + 'fake.dump', 1 << 20)");
+  eval("it = leveldbNewIterator(db); leveldbIteratorSeek(it, 'fake');");
+  EXPECT_EQ(blobFiles("a.db"), 1);
+  EXPECT_EQ(json("Array.from(new Uint8Array(leveldbIteratorValueBuf(it)))"), json("Array.from(fake)"));
+  eval("leveldbIteratorDelete(it);");
+
+  // Checkpoints and destroys take the blob files along.
+  eval("var b = leveldbOpen('b.db', true, true, {blobThreshold: 1000}); leveldbPut(b, 'big', big);");
+  await("leveldbCheckpointAsync(b, 'c.db')");
+  eval("leveldbClose(b); leveldbDestroy('b.db'); var c = leveldbOpen('c.db', false, false);");
+  EXPECT_EQ(blobFiles("b.db"), -1);
+  EXPECT_EQ(str("leveldbGet(c, 'big')").size(), 5000u);
+}
+
+}  // namespace
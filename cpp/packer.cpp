@@ -79,6 +79,206 @@ void pack(const jsi::Value& value, jsi::Runtime& runtime, mpack_writer_t* writer
     }
 }
 
+void snapshot(const jsi::Value& value, jsi::Runtime& runtime, Node* node) {
+    if(value.isString()) {
+
+        node->type = Node::kString;
+        node->string = value.getString(runtime).utf8(runtime);
+
+    } else if(value.isNumber()) {
+
+        node->type = Node::kNumber;
+        node->number = value.getNumber();
+
+    } else if(value.isBool()) {
+
+        node->type = Node::kBool;
+        node->boolean = value.getBool();
+
+    } else if(value.isNull()) {
+
+        node->type = Node::kNil;
+
+    } else if(value.isUndefined()) {
+
+        node->type = Node::kUndefined;
+
+    } else if(value.isSymbol()) {
+
+        throw jsi::JSError(runtime, "pack/ symbols are not supported");
+
+    } else if(value.isObject()) {
+
+        auto obj = value.getObject(runtime);
+
+        if(obj.isArray(runtime)) {
+
+            auto array = obj.getArray(runtime);
+            auto size = array.size(runtime);
+            node->type = Node::kArray;
+            node->children.resize(size);
+            for(size_t i=0; i<size; i++) {
+                snapshot(array.getValueAtIndex(runtime, i), runtime, &node->children[i]);
+            }
+
+        } else if(obj.isFunction(runtime)) {
+
+            throw jsi::JSError(runtime, "pack/ functions are not supported");
+
+        } else if(obj.isArrayBuffer(runtime)) {
+
+            throw jsi::JSError(runtime, "pack/ ArrayBuffers are not supported");
+
+        } else {
+
+            auto keys = obj.getPropertyNames(runtime);
+            auto keyCount = keys.size(runtime);
+            node->type = Node::kMap;
+            node->keys.resize(keyCount);
+            node->children.resize(keyCount);
+            for (size_t i=0;i < keyCount; i++) {
+                auto key = keys.getValueAtIndex(runtime, i).getString(runtime);
+                node->keys[i] = key.utf8(runtime);
+                snapshot(obj.getProperty(runtime, key), runtime, &node->children[i]);
+            }
+        }
+    }
+}
+
+void pack(const Node& node, mpack_writer_t* writer) {
+    switch (node.type) {
+        case Node::kString:
+            // Like pack(), stops at the first NUL.
+            mpack_write_cstr(writer, node.string.c_str());
+            break;
+        case Node::kNumber:
+            mpack_write(writer, node.number);
+            break;
+        case Node::kBool:
+            mpack_write(writer, node.boolean);
+            break;
+        case Node::kNil:
+            mpack_write_nil(writer);
+            break;
+        case Node::kUndefined:
+            mpack_start_bin(writer, 1);
+            mpack_write_bytes(writer, "u", 1);
+            mpack_finish_bin(writer);
+            break;
+        case Node::kArray:
+            mpack_start_array(writer, node.children.size());
+            for (const Node& child : node.children) {
+                pack(child, writer);
+            }
+            mpack_finish_array(writer);
+            break;
+        case Node::kMap:
+            mpack_start_map(writer, node.children.size());
+            for (size_t i = 0; i < node.children.size(); i++) {
+                mpack_write_cstr(writer, node.keys[i].c_str());
+                pack(node.children[i], writer);
+            }
+            mpack_finish_map(writer);
+            break;
+    }
+}
+
+static bool parseNode(mpack_node_t in, int depth, Node* node) {
+    if (depth >= 32) { // same limit as unpackElement()
+        return false;
+    }
+    switch (mpack_node_type(in)) {
+        case mpack_type_nil:
+            node->type = Node::kNil;
+            return true;
+        case mpack_type_bin:
+            // We only use bin for undefined so far.
+            node->type = Node::kUndefined;
+            return true;
+        case mpack_type_bool:
+            node->type = Node::kBool;
+            node->boolean = mpack_node_bool(in);
+            return true;
+        case mpack_type_double:
+            node->type = Node::kNumber;
+            node->number = mpack_node_double(in);
+            return true;
+        case mpack_type_str:
+            node->type = Node::kString;
+            node->string.assign(mpack_node_str(in), mpack_node_strlen(in));
+            return true;
+        case mpack_type_array: {
+            size_t count = mpack_node_array_length(in);
+            node->type = Node::kArray;
+            node->children.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                if (!parseNode(mpack_node_array_at(in, i), depth + 1, &node->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case mpack_type_map: {
+            size_t count = mpack_node_map_count(in);
+            node->type = Node::kMap;
+            node->keys.resize(count);
+            node->children.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                mpack_node_t key = mpack_node_map_key_at(in, i);
+                if (mpack_node_type(key) != mpack_type_str) {
+                    return false;
+                }
+                node->keys[i].assign(mpack_node_str(key), mpack_node_strlen(key));
+                if (!parseNode(mpack_node_map_value_at(in, i), depth + 1, &node->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool parse(const char* data, size_t size, Node* node) {
+    mpack_tree_t tree;
+    mpack_tree_init_data(&tree, data, size);
+    mpack_tree_parse(&tree);
+    bool ok = mpack_tree_error(&tree) == mpack_ok && parseNode(mpack_tree_root(&tree), 0, node);
+    return mpack_tree_destroy(&tree) == mpack_ok && ok;
+}
+
+jsi::Value toValue(jsi::Runtime& runtime, const Node& node) {
+    switch (node.type) {
+        case Node::kNil:
+            return {nullptr};
+        case Node::kUndefined:
+            return jsi::Value::undefined();
+        case Node::kBool:
+            return {node.boolean};
+        case Node::kNumber:
+            return {node.number};
+        case Node::kString:
+            return jsi::String::createFromUtf8(runtime, (const uint8_t*)node.string.data(), node.string.size());
+        case Node::kArray: {
+            jsi::Array array(runtime, node.children.size());
+            for (size_t i = 0; i < node.children.size(); i++) {
+                array.setValueAtIndex(runtime, i, toValue(runtime, node.children[i]));
+            }
+            return array;
+        }
+        case Node::kMap: {
+            jsi::Object object(runtime);
+            for (size_t i = 0; i < node.children.size(); i++) {
+                object.setProperty(runtime, jsi::String::createFromUtf8(runtime, node.keys[i]),
+                                   toValue(runtime, node.children[i]));
+            }
+            return object;
+        }
+    }
+    return jsi::Value::undefined();
+}
+
 jsi::Value unpackElement(jsi::Runtime& runtime, mpack_reader_t* reader, int depth) {
     if (depth >= 32) { // critical check!
         mpack_reader_flag_error(reader, mpack_error_too_big);
@@ -2,6 +2,8 @@
 #define packer_h
 
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include <jsi/jsi.h>
 
 #import "mpack.h"
@@ -10,5 +12,27 @@ using namespace facebook;
 namespace Packer {
     jsi::Value unpackElement(jsi::Runtime& runtime, mpack_reader_t* reader, int depth);
     void pack(const jsi::Value& value, jsi::Runtime& runtime, mpack_writer_t* writer);
+
+    // A JS value copied out of the runtime, so that it can be encoded off the JS thread.
+    struct Node {
+        enum Type { kNil, kUndefined, kBool, kNumber, kString, kArray, kMap };
+        Type type = kNil;
+        bool boolean = false;
+        double number = 0;
+        // The string, or the keys of a map.
+        std::string string;
+        std::vector<std::string> keys;
+        // The elements of an array, or the values of a map.
+        std::vector<Node> children;
+    };
+    // Throws a JSError for the values that pack() refuses.
+    void snapshot(const jsi::Value& value, jsi::Runtime& runtime, Node* node);
+    // Writes the same bytes as pack() does for the value `node` was snapshotted from. Safe to call on any thread.
+    void pack(const Node& node, mpack_writer_t* writer);
+    // Reads a value written by pack(), with mpack's node API, into `node`. Returns false if the data is malformed, or
+    // nested deeper than unpackElement() allows. Safe to call on any thread.
+    bool parse(const char* data, size_t size, Node* node);
+    // The JS value that unpackElement() returns for the same data.
+    jsi::Value toValue(jsi::Runtime& runtime, const Node& node);
 }
 #endif /* packer_h */
@@ -0,0 +1,95 @@
+#include "range-write-batch.h"
+
+#include <memory>
+
+namespace {
+
+// Collects the keys put by a batch that fall in [gte, lt).
+class KeysInRange : public leveldb::WriteBatch::Handler {
+ public:
+  KeysInRange(const leveldb::Comparator* comparator, const std::string& gte, const std::string& lt)
+      : comparator_(comparator), gte_(gte), lt_(lt) {}
+
+  void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+    if (comparator_->Compare(key, gte_) >= 0 && comparator_->Compare(key, lt_) < 0) {
+      keys.push_back(key.ToString());
+    }
+  }
+
+  void Delete(const leveldb::Slice& key) override {}
+
+  std::vector<std::string> keys;
+
+ private:
+  const leveldb::Comparator* comparator_;
+  const std::string& gte_;
+  const std::string& lt_;
+};
+
+}  // namespace
+
+leveldb::WriteBatch& RangeWriteBatch::batch() {
+  if (segments_.back().hasRange) {
+    segments_.emplace_back();
+  }
+  return segments_.back().batch;
+}
+
+void RangeWriteBatch::put(const leveldb::Slice& key, const leveldb::Slice& value) {
+  batch().Put(key, value);
+}
+
+void RangeWriteBatch::del(const leveldb::Slice& key) {
+  batch().Delete(key);
+}
+
+void RangeWriteBatch::deleteRange(std::string gte, std::string lt) {
+  batch();
+  Segment& segment = segments_.back();
+  segment.hasRange = true;
+  segment.gte = std::move(gte);
+  segment.lt = std::move(lt);
+}
+
+void RangeWriteBatch::clear() {
+  segments_.clear();
+  segments_.emplace_back();
+}
+
+size_t RangeWriteBatch::approximateSize() const {
+  size_t size = 0;
+  for (const Segment& segment : segments_) {
+    size += segment.batch.ApproximateSize() + segment.gte.size() + segment.lt.size();
+  }
+  return size;
+}
+
+leveldb::Status RangeWriteBatch::commit(DbHandle& db, const leveldb::WriteOptions& options) {
+  if (segments_.size() == 1 && !segments_[0].hasRange) {
+    return db.write(options, &segments_[0].batch);
+  }
+
+  return db.update(options, [&](leveldb::WriteBatch* out) {
+    for (const Segment& segment : segments_) {
+      out->Append(segment.batch);
+      if (!segment.hasRange) {
+        continue;
+      }
+      const leveldb::Comparator* comparator = db.comparator();
+      KeysInRange putKeys(comparator, segment.gte, segment.lt);
+      out->Iterate(&putKeys);
+      for (const std::string& key : putKeys.keys) {
+        out->Delete(key);
+      }
+      // Writes are held off until the batch is committed, so the range can't change meanwhile.
+      std::unique_ptr<leveldb::Iterator> it(db.newIterator(leveldb::ReadOptions()));
+      for (it->Seek(segment.gte); it->Valid() && comparator->Compare(it->key(), segment.lt) < 0; it->Next()) {
+        out->Delete(it->key());
+      }
+      if (!it->status().ok()) {
+        return it->status();
+      }
+    }
+    return leveldb::Status::OK();
+  });
+}
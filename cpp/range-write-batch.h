@@ -0,0 +1,42 @@
+#ifndef range_write_batch_h
+#define range_write_batch_h
+
+#include <string>
+#include <vector>
+#include <leveldb/status.h>
+#include <leveldb/write_batch.h>
+#include "db-handle.h"
+
+// A WriteBatch that can also delete ranges of keys. LevelDB has no range deletes: they are expanded into deletes of
+// the keys in the range when the batch is committed, atomically with the rest of the batch (see DbHandle::update()).
+// Operations apply in order, so a range delete also deletes the keys put before it in the batch.
+class RangeWriteBatch {
+ public:
+  RangeWriteBatch() : segments_(1) {}
+
+  void put(const leveldb::Slice& key, const leveldb::Slice& value);
+  void del(const leveldb::Slice& key);
+  // Deletes the keys in [gte, lt), in the order of the DB that the batch is committed to.
+  void deleteRange(std::string gte, std::string lt);
+  void clear();
+  // The size of the batch, not counting the keys that range deletes will expand to.
+  size_t approximateSize() const;
+
+  // The batch stays as is, it can be committed again.
+  leveldb::Status commit(DbHandle& db, const leveldb::WriteOptions& options);
+
+ private:
+  // Writes, then optionally a range delete. Writes after a range delete go to a new segment.
+  struct Segment {
+    leveldb::WriteBatch batch;
+    bool hasRange = false;
+    std::string gte;
+    std::string lt;
+  };
+
+  leveldb::WriteBatch& batch();
+
+  std::vector<Segment> segments_;
+};
+
+#endif /* range_write_batch_h */
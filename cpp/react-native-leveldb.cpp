@@ -1,20 +1,111 @@
 #import "react-native-leveldb.h"
 #import "packer.h"
-
+#import "handle-table.h"
+#import "db-handle.h"
+#import "async.h"
+#import "dump.h"
+#import "file-reader.h"
+#import "comparators.h"
+#import "tuple.h"
+#import "ttl.h"
+#import "range-write-batch.h"
+#import "warmup.h"
+#import "checkpoint.h"
+#import "blob.h"
+
+#include <condition_variable>
 #include <iostream>
-#include <fstream>
 #include <sstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <climits>
+#include <cstring>
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 #include <leveldb/filter_policy.h>
 
 using namespace facebook;
 
-// TODO(savv): consider re-using unique_ptrs, if they are empty.
-std::vector<std::unique_ptr<leveldb::DB>> dbs;
-std::vector<std::unique_ptr<leveldb::Iterator>> iterators;
+HandleTable<DbHandle> dbs;
+HandleTable<IteratorHandle> iterators;
+
+// Maps DB paths to their index in `dbs`, so that opening an already open path shares the existing handle instead of
+// failing on LevelDB's LOCK file. Also guards DbHandle::openCount.
+std::mutex openPathsMutex;
+std::unordered_map<std::string, int> openPaths;
+
+// Number of runtimes that called installLeveldb() without a matching cleanupLeveldb().
+std::atomic<int> installedRuntimes{0};
+
+// The watches that each runtime added, by the index of the DB they're on. Their callbacks run on that runtime, so they
+// are removed when it closes the DB or cleans up, even if another runtime keeps the DB open.
+std::mutex runtimeWatchesMutex;
+std::unordered_map<jsi::Runtime*, std::unordered_map<int, std::unordered_set<int>>> runtimeWatches;
+
+// Removes the watches that `runtime` added on the DB at `idx`, or on all DBs if `idx` is -1.
+void unwatchAll(jsi::Runtime& runtime, int idx) {
+  std::unordered_map<int, std::unordered_set<int>> removed;
+  {
+    std::lock_guard<std::mutex> lock(runtimeWatchesMutex);
+    auto watches = runtimeWatches.find(&runtime);
+    if (watches == runtimeWatches.end()) {
+      return;
+    }
+    if (idx == -1) {
+      removed.swap(watches->second);
+    } else {
+      auto db = watches->second.find(idx);
+      if (db == watches->second.end()) {
+        return;
+      }
+      removed[idx].swap(db->second);
+      watches->second.erase(db);
+    }
+    if (watches->second.empty()) {
+      runtimeWatches.erase(watches);
+    }
+  }
+  for (auto& db : removed) {
+    std::shared_ptr<DbHandle> handle = dbs.get(db.first);
+    if (!handle) {
+      continue;
+    }
+    for (int id : db.second) {
+      handle->watchers.remove(id);
+    }
+  }
+}
+
+// Bloom filter policies shared between the DBs opened with `sharedFilterPolicy`, by bits per key. A policy is freed
+// once the last DB using it closes.
+std::mutex sharedFilterPoliciesMutex;
+std::unordered_map<int, std::weak_ptr<const leveldb::FilterPolicy>> sharedFilterPolicies;
+
+// Returns nullptr for bitsPerKey == 0, which disables Bloom filters.
+std::shared_ptr<const leveldb::FilterPolicy> newFilterPolicy(int bitsPerKey, bool shared) {
+  if (bitsPerKey == 0) {
+    return nullptr;
+  }
+  if (!shared) {
+    return std::shared_ptr<const leveldb::FilterPolicy>(leveldb::NewBloomFilterPolicy(bitsPerKey));
+  }
+  std::lock_guard<std::mutex> lock(sharedFilterPoliciesMutex);
+  std::shared_ptr<const leveldb::FilterPolicy> policy = sharedFilterPolicies[bitsPerKey].lock();
+  if (!policy) {
+    policy.reset(leveldb::NewBloomFilterPolicy(bitsPerKey));
+    sharedFilterPolicies[bitsPerKey] = policy;
+  }
+  return policy;
+}
 
-// Returns false if the passed value is not a string or an ArrayBuffer.
+// Returns false if the passed value is not a string, an ArrayBuffer or a tuple. Tuples (arrays) are encoded with
+// Tuple::encode(), which throws if they hold something that can't be encoded.
 bool valueToString(jsi::Runtime& runtime, const jsi::Value& value, std::string* str) {
   if (value.isString()) {
     *str = value.asString(runtime).utf8(runtime);
@@ -23,6 +114,10 @@ bool valueToString(jsi::Runtime& runtime, const jsi::Value& value, std::string*
 
   if (value.isObject()) {
     auto obj = value.asObject(runtime);
+    if (obj.isArray(runtime)) {
+      *str = Tuple::encode(runtime, obj.getArray(runtime));
+      return true;
+    }
     if (!obj.isArrayBuffer(runtime)) {
       return false;
     }
@@ -34,37 +129,613 @@ bool valueToString(jsi::Runtime& runtime, const jsi::Value& value, std::string*
   return false;
 }
 
-leveldb::DB* valueToDb(const jsi::Value& value, std::string* err) {
+// Reads the optional string or ArrayBuffer parameter at `arguments[idx]`: `*str` is left null if it's undefined or null.
+// Returns false if it's set to something else.
+bool argumentToOptionalString(jsi::Runtime& runtime, const jsi::Value* arguments, size_t count, size_t idx,
+                              std::shared_ptr<std::string>* str) {
+  if (idx >= count || arguments[idx].isUndefined() || arguments[idx].isNull()) {
+    return true;
+  }
+  *str = std::make_shared<std::string>();
+  return valueToString(runtime, arguments[idx], str->get());
+}
+
+std::shared_ptr<DbHandle> valueToDb(const jsi::Value& value, std::string* err) {
   if (!value.isNumber()) {
     *err = "valueToDb/param-not-a-number";
     return nullptr;
   }
   int idx = (int)value.getNumber();
-  if (idx < 0 || idx >= dbs.size()) {
+  if (!dbs.issued(idx)) {
     *err = "valueToDb/idx-out-of-range";
     return nullptr;
   }
-  if (!dbs[idx].get()) {
+  std::shared_ptr<DbHandle> handle = dbs.get(idx);
+  if (!handle) {
     *err = "valueToDb/db-closed";
     return nullptr;
   }
 
-  return dbs[idx].get();
+  return handle;
+}
+
+// Returns the options for a write whose optional `sync` parameter is at `arguments[idx]`. An explicit boolean wins over
+// the DB's default durability.
+leveldb::WriteOptions argumentToWriteOptions(const DbHandle& db, const jsi::Value* arguments, size_t count, size_t idx) {
+  leveldb::WriteOptions options = db.writeOptions();
+  if (idx < count && arguments[idx].isBool()) {
+    options.sync = arguments[idx].getBool();
+  }
+  return options;
+}
+
+// Returns false if `value` isn't the name of a profile.
+bool valueToProfile(jsi::Runtime& runtime, const jsi::Value& value, DbProfile* profile) {
+  if (!value.isString()) {
+    return false;
+  }
+  std::string name = value.asString(runtime).utf8(runtime);
+  if (name == "interactive") {
+    *profile = DbProfile::kInteractive;
+  } else if (name == "bulkLoad") {
+    *profile = DbProfile::kBulkLoad;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Reads the optional integer option `name` into `*out`. Returns false if it's set to something else, or to less than
+// `min`.
+bool getIntOption(jsi::Runtime& runtime, const jsi::Object& options, const char* name, int min, int* out) {
+  jsi::Value value = options.getProperty(runtime, name);
+  if (value.isUndefined()) {
+    return true;
+  }
+  if (!value.isNumber() || value.getNumber() < min || value.getNumber() > INT_MAX) {
+    return false;
+  }
+  *out = (int)value.getNumber();
+  return true;
+}
+
+// Reads the `prefetch` open option, a list of {gte, lt} ranges whose bounds are optional.
+bool valueToWarmupRanges(jsi::Runtime& runtime, const jsi::Value& value, std::vector<Warmup::Range>* ranges) {
+  if (value.isUndefined()) {
+    return true;
+  }
+  if (!value.isObject() || !value.getObject(runtime).isArray(runtime)) {
+    return false;
+  }
+  jsi::Array array = value.getObject(runtime).getArray(runtime);
+  for (size_t i = 0; i < array.size(runtime); i++) {
+    jsi::Value element = array.getValueAtIndex(runtime, i);
+    if (!element.isObject()) {
+      return false;
+    }
+    jsi::Object object = element.getObject(runtime);
+    jsi::Value bounds[] = {object.getProperty(runtime, "gte"), object.getProperty(runtime, "lt")};
+    Warmup::Range range;
+    if (!argumentToOptionalString(runtime, bounds, 2, 0, &range.gte) ||
+        !argumentToOptionalString(runtime, bounds, 2, 1, &range.lt)) {
+      return false;
+    }
+    ranges->push_back(std::move(range));
+  }
+  return true;
+}
+
+// Reads the optional `ttlMs` parameter at `arguments[idx]` into the header of the values to write: left empty if the
+// parameter is undefined or null. Returns false if it's set to something other than a positive number.
+bool argumentToTtlHeader(const jsi::Value* arguments, size_t count, size_t idx, std::string* header) {
+  if (idx >= count || arguments[idx].isUndefined() || arguments[idx].isNull()) {
+    return true;
+  }
+  if (!arguments[idx].isNumber() || !(arguments[idx].getNumber() > 0)) {
+    return false;
+  }
+  *header = Ttl::header(Ttl::now() + (int64_t)std::min(arguments[idx].getNumber(), 1e15));
+  return true;
+}
+
+// Raw values, stored as is, can't start with 0xc1: msgpack never does, which is what tells TTL headers and blob pointers
+// apart from the values stored by leveldbPut().
+bool isReservedRawValue(const char* data, size_t size) {
+  return size > 0 && (uint8_t)data[0] == 0xc1;
+}
+
+// Decodes a value as stored by leveldbPut(), without its TTL header. `fn` prefixes the error thrown if it's malformed.
+jsi::Value unpackValue(jsi::Runtime& runtime, const leveldb::Slice& value, const char* fn) {
+  mpack_reader_t reader;
+  mpack_reader_init_data(&reader, value.data(), value.size());
+  jsi::Value parsed;
+  try {
+    parsed = Packer::unpackElement(runtime, &reader, 0);
+  } catch (...) {
+    mpack_reader_destroy(&reader);
+    throw;
+  }
+  if (mpack_ok != mpack_reader_destroy(&reader)) {
+    throw jsi::JSError(runtime, std::string(fn) + "/ failed to read data");
+  }
+  return parsed;
+}
+
+// Encodes a value as leveldbPut() stores it, appending it to `*out`. `fn` prefixes the error thrown if it can't be.
+void packValue(jsi::Runtime& runtime, const jsi::Value& value, const char* fn, std::string* out) {
+  mpack_writer_t writer;
+  char* buf = nullptr;
+  size_t size = 0;
+  mpack_writer_init_growable(&writer, &buf, &size);
+  try {
+    Packer::pack(value, runtime, &writer);
+  } catch (...) {
+    mpack_writer_destroy(&writer);
+    MPACK_FREE(buf);
+    throw;
+  }
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    MPACK_FREE(buf);
+    throw jsi::JSError(runtime, std::string(fn) + "/ an error occurred encoding the data");
+  }
+  out->append(buf, size);
+  MPACK_FREE(buf);
+}
+
+// Like packValue(), for a value copied out of the runtime. Returns false if it can't be encoded. Safe to call on any
+// thread.
+bool packNode(const Packer::Node& node, std::string* out) {
+  mpack_writer_t writer;
+  char* buf = nullptr;
+  size_t size = 0;
+  mpack_writer_init_growable(&writer, &buf, &size);
+  Packer::pack(node, &writer);
+  if (mpack_writer_destroy(&writer) != mpack_ok) {
+    MPACK_FREE(buf);
+    return false;
+  }
+  out->append(buf, size);
+  MPACK_FREE(buf);
+  return true;
 }
 
-leveldb::Iterator* valueToIterator(const jsi::Value& value) {
+// Returns false if `value` isn't an instance of the typed array class `type`, e.g. "Float64Array". Otherwise points
+// `*data` to its bytes, which stay valid until JS runs again.
+bool typedArrayBytes(jsi::Runtime& runtime, const jsi::Value& value, const char* type, const uint8_t** data,
+                     size_t* size) {
+  if (!value.isObject()) {
+    return false;
+  }
+  jsi::Object array = value.getObject(runtime);
+  if (!array.instanceOf(runtime, runtime.global().getPropertyAsFunction(runtime, type))) {
+    return false;
+  }
+  jsi::ArrayBuffer buffer = array.getPropertyAsObject(runtime, "buffer").getArrayBuffer(runtime);
+  *data = buffer.data(runtime) + (size_t)array.getProperty(runtime, "byteOffset").getNumber();
+  *size = (size_t)array.getProperty(runtime, "byteLength").getNumber();
+  return true;
+}
+
+// The ways keys can be returned to JS.
+enum class KeyFormat { kBuffer, kString, kTuple };
+
+// Returns false if `value` isn't 'buffer', 'string' or 'tuple'.
+bool valueToKeyFormat(jsi::Runtime& runtime, const jsi::Value& value, KeyFormat* format) {
+  if (!value.isString()) {
+    return false;
+  }
+  std::string name = value.asString(runtime).utf8(runtime);
+  if (name == "buffer") {
+    *format = KeyFormat::kBuffer;
+  } else if (name == "string") {
+    *format = KeyFormat::kString;
+  } else if (name == "tuple") {
+    *format = KeyFormat::kTuple;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+jsi::Value keyToValue(jsi::Runtime& runtime, const leveldb::Slice& key, KeyFormat format) {
+  switch (format) {
+    case KeyFormat::kString:
+      return jsi::String::createFromUtf8(runtime, key.ToString());
+    case KeyFormat::kTuple:
+      return Tuple::decode(runtime, key.data(), key.size());
+    default:
+      return newArrayBuffer(runtime, key.data(), key.size());
+  }
+}
+
+// Splits a stored value into its TTL header (left empty if it has none) and its msgpack value. Returns false if it
+// has expired.
+bool splitTtlHeader(const std::string& stored, std::string* header, leveldb::Slice* value) {
+  *value = stored;
+  if (!Ttl::live(value, Ttl::now())) {
+    return false;
+  }
+  header->assign(stored.data(), stored.size() - value->size());
+  return true;
+}
+
+// The JS side of a RangeWriteBatch, built with leveldbNewWriteBatch() and committed with leveldbWrite(). Operations
+// are encoded as they're added, so a large batch is built up natively rather than passed as one huge JS object. Each
+// operation returns the batch, so that they can be chained.
+class WriteBatchHostObject : public jsi::HostObject {
+ public:
+  jsi::Value get(jsi::Runtime& runtime, const jsi::PropNameID& name) override {
+    std::string prop = name.utf8(runtime);
+    std::shared_ptr<RangeWriteBatch> batch = batch_;
+
+    if (prop == "put") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          3,  // key, value, options
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            std::string key, ttlHeader;
+            if (count < 2 || !valueToString(runtime, arguments[0], &key)) {
+              throw jsi::JSError(runtime, "leveldbWriteBatch/invalid-params");
+            }
+            if (count > 2 && arguments[2].isObject()) {
+              jsi::Value ttlMs = arguments[2].getObject(runtime).getProperty(runtime, "ttlMs");
+              if (!argumentToTtlHeader(&ttlMs, 1, 0, &ttlHeader)) {
+                throw jsi::JSError(runtime, "leveldbWriteBatch/invalid-params");
+              }
+            }
+            packValue(runtime, arguments[1], "leveldbWriteBatch", &ttlHeader);
+            batch->put(key, ttlHeader);
+            return jsi::Value(runtime, thisValue);
+          });
+    }
+
+    if (prop == "putRaw") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          2,  // key, value
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            // The value is stored as is: a string (as UTF-8) or an ArrayBuffer, not a tuple.
+            std::string key, value;
+            if (count < 2 || !valueToString(runtime, arguments[0], &key) ||
+                (arguments[1].isObject() && arguments[1].getObject(runtime).isArray(runtime)) ||
+                !valueToString(runtime, arguments[1], &value)) {
+              throw jsi::JSError(runtime, "leveldbWriteBatch/invalid-params");
+            }
+            if (isReservedRawValue(value.data(), value.size())) {
+              throw jsi::JSError(runtime, "leveldbWriteBatch/reserved-raw-value");
+            }
+            batch->put(key, value);
+            return jsi::Value(runtime, thisValue);
+          });
+    }
+
+    if (prop == "delete") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          1,  // key
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            std::string key;
+            if (count < 1 || !valueToString(runtime, arguments[0], &key)) {
+              throw jsi::JSError(runtime, "leveldbWriteBatch/invalid-params");
+            }
+            batch->del(key);
+            return jsi::Value(runtime, thisValue);
+          });
+    }
+
+    if (prop == "deleteRange") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          2,  // gte, lt
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            std::string gte, lt;
+            if (count < 2 || !valueToString(runtime, arguments[0], &gte) || !valueToString(runtime, arguments[1], &lt)) {
+              throw jsi::JSError(runtime, "leveldbWriteBatch/invalid-params");
+            }
+            batch->deleteRange(std::move(gte), std::move(lt));
+            return jsi::Value(runtime, thisValue);
+          });
+    }
+
+    if (prop == "clear") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          0,
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            batch->clear();
+            return jsi::Value(runtime, thisValue);
+          });
+    }
+
+    if (prop == "approximateSize") {
+      return jsi::Function::createFromHostFunction(
+          runtime, name,
+          0,
+          [batch](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+            return jsi::Value((double)batch->approximateSize());
+          });
+    }
+
+    return jsi::Value::undefined();
+  }
+
+  std::vector<jsi::PropNameID> getPropertyNames(jsi::Runtime& runtime) override {
+    std::vector<jsi::PropNameID> names;
+    for (const char* name : {"put", "putRaw", "delete", "deleteRange", "clear", "approximateSize"}) {
+      names.push_back(jsi::PropNameID::forAscii(runtime, name));
+    }
+    return names;
+  }
+
+  // Shared with the functions that get() hands out, which may outlive the host object.
+  const std::shared_ptr<RangeWriteBatch> batch_ = std::make_shared<RangeWriteBatch>();
+};
+
+// The returned pointer keeps the iterator (and its DB) alive, even if another runtime deletes it concurrently.
+std::shared_ptr<leveldb::Iterator> valueToIterator(const jsi::Value& value) {
   if (!value.isNumber()) {
     return nullptr;
   }
-  int idx = (int)value.getNumber();
-  if (idx < 0 || idx >= iterators.size()) {
+  std::shared_ptr<IteratorHandle> handle = iterators.get((int)value.getNumber());
+  if (!handle) {
     return nullptr;
   }
+  return std::shared_ptr<leveldb::Iterator>(handle, handle->iterator.get());
+}
 
-  return iterators[idx].get();
+// The smallest key that sorts after all keys starting with `prefix`, bytewise. Empty if there is none, i.e. if the
+// prefix is all 0xff bytes.
+std::string prefixSuccessor(std::string prefix) {
+  while (!prefix.empty() && (uint8_t)prefix.back() == 0xff) {
+    prefix.pop_back();
+  }
+  if (!prefix.empty()) {
+    prefix.back()++;
+  }
+  return prefix;
 }
 
-void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
+// How much leveldbOpen() prefetches by default: LevelDB's default block cache size, past which the prefetch would
+// evict what it read first.
+const int kDefaultPrefetchBytes = 8 * 1024 * 1024;
+
+// The number of values that a worker encodes or decodes at a time, for leveldbBatchObjectsAsync() and
+// leveldbGetAllObjectsAsync().
+const size_t kParallelChunkEntries = 256;
+
+// The size of the batches that merges commit, unless they need to be atomic.
+const size_t kMergeChunkBytes = 4 * 1024 * 1024;
+
+// Copies all entries of `src` into `dst`, committing them in batches of about `chunkBytes`, so that memory use stays
+// bounded however large `src` is. If set, `onChunk` is called after each commit, with the number of entries merged so
+// far and the approximate fraction of `src` that they represent.
+leveldb::Status mergeInChunks(DbHandle& dst, DbHandle& src, size_t chunkBytes,
+                              const std::function<void(uint64_t, double)>& onChunk) {
+  leveldb::ReadOptions readOptions;
+  // A one-off scan: don't evict the blocks that the app is actually using from the cache.
+  readOptions.fill_cache = false;
+  std::unique_ptr<leveldb::Iterator> it(src.newIterator(readOptions));
+
+  uint64_t totalBytes = 0;
+  if (onChunk) {
+    it->SeekToLast();
+    if (it->Valid()) {
+      // Leaves out the last entry, but doesn't depend on the key order, unlike computing a key past it.
+      std::string limit = it->key().ToString();
+      it->SeekToFirst();
+      leveldb::Range range(it->key(), limit);
+      totalBytes = src.approximateSize(range);
+    }
+  }
+
+  uint64_t merged = 0, mergedBytes = 0;
+  leveldb::WriteBatch batch;
+  auto commit = [&]() {
+    leveldb::Status status = dst.write(dst.writeOptions(), &batch);
+    batch.Clear();
+    if (status.ok() && onChunk) {
+      onChunk(merged, totalBytes == 0 ? 1.0 : std::min(1.0, (double)mergedBytes / totalBytes));
+    }
+    return status;
+  };
+
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    batch.Put(it->key(), it->value());
+    merged++;
+    mergedBytes += it->key().size() + it->value().size();
+    if (batch.ApproximateSize() >= chunkBytes) {
+      leveldb::Status status = commit();
+      if (!status.ok()) {
+        return status;
+      }
+    }
+  }
+  if (!it->status().ok()) {
+    return it->status();
+  }
+  return commit();
+}
+
+// What leveldbOpen() and leveldbOpenAsync() are asked to open, read from their arguments on the JS thread.
+struct OpenParams {
+  std::string path;
+  leveldb::Options options;
+  bool syncByDefault = false;
+  bool readOnly = false;
+  int bloomBitsPerKey = 10;
+  bool sharedFilterPolicy = false;
+  DbProfile profile = DbProfile::kInteractive;
+  std::vector<Warmup::Range> prefetch;
+  int recordWarmupMs = 0;
+  int prefetchBytes = kDefaultPrefetchBytes;
+  int blobThreshold = 0;
+};
+
+// Throws a JSError prefixed with `fn` if the arguments are invalid.
+OpenParams argumentsToOpenParams(jsi::Runtime& runtime, const std::string& documentDir, const jsi::Value* arguments,
+                                 size_t count, const char* fn) {
+  if (!arguments[0].isString() || !arguments[1].isBool() || !arguments[2].isBool()) {
+    throw jsi::JSError(runtime, std::string(fn) + "/invalid-params");
+  }
+
+  OpenParams params;
+  leveldb::Options& options = params.options;
+  params.path = documentDir + arguments[0].getString(runtime).utf8(runtime);
+  options.create_if_missing = arguments[1].getBool();
+  options.error_if_exists = arguments[2].getBool();
+  options.compression = leveldb::CompressionType::kNoCompression;
+  options.reuse_logs = true;
+
+  if (count > 3 && arguments[3].isObject()) {
+    jsi::Object openOptions = arguments[3].asObject(runtime);
+    jsi::Value sync = openOptions.getProperty(runtime, "sync");
+    params.syncByDefault = sync.isBool() && sync.getBool();
+    jsi::Value shared = openOptions.getProperty(runtime, "sharedFilterPolicy");
+    params.sharedFilterPolicy = shared.isBool() && shared.getBool();
+    jsi::Value readOnly = openOptions.getProperty(runtime, "readOnly");
+    params.readOnly = readOnly.isBool() && readOnly.getBool();
+
+    int blockSize = (int)options.block_size;
+    int writeBufferSize = (int)options.write_buffer_size;
+    if (!getIntOption(runtime, openOptions, "bloomBitsPerKey", 0, &params.bloomBitsPerKey)
+        || !getIntOption(runtime, openOptions, "blockSize", 1, &blockSize)
+        || !getIntOption(runtime, openOptions, "writeBufferSize", 1, &writeBufferSize)
+        || !getIntOption(runtime, openOptions, "maxOpenFiles", 1, &options.max_open_files)
+        || !getIntOption(runtime, openOptions, "recordWarmupMs", 0, &params.recordWarmupMs)
+        || !getIntOption(runtime, openOptions, "prefetchBytes", 0, &params.prefetchBytes)
+        || !getIntOption(runtime, openOptions, "blobThreshold", 0, &params.blobThreshold)
+        || !valueToWarmupRanges(runtime, openOptions.getProperty(runtime, "prefetch"), &params.prefetch)) {
+      throw jsi::JSError(runtime, std::string(fn) + "/invalid-options");
+    }
+    jsi::Value comparator = openOptions.getProperty(runtime, "comparator");
+    if (!comparator.isUndefined()) {
+      if (!comparator.isString() || !(options.comparator = Comparators::named(comparator.asString(runtime).utf8(runtime)))) {
+        throw jsi::JSError(runtime, std::string(fn) + "/invalid-options");
+      }
+    }
+    jsi::Value profileName = openOptions.getProperty(runtime, "profile");
+    if (!profileName.isUndefined() && !valueToProfile(runtime, profileName, &params.profile)) {
+      throw jsi::JSError(runtime, std::string(fn) + "/invalid-options");
+    }
+    options.block_size = (size_t)blockSize;
+    options.write_buffer_size = (size_t)writeBufferSize;
+  }
+  return params;
+}
+
+// Applies the options that take effect once the DB is open.
+void setUpOpenedDb(const OpenParams& params, const std::shared_ptr<DbHandle>& handle) {
+  handle->syncByDefault = params.syncByDefault;
+  // Read-only DBs replay the recording of the DB they're a checkpoint of, but leave the recording to it.
+  std::string sidecar = Warmup::sidecarPath(params.path);
+  if (params.recordWarmupMs > 0 && !params.readOnly) {
+    handle->warmupRecorder.start(sidecar, std::chrono::milliseconds(params.recordWarmupMs));
+  }
+  if ((!params.prefetch.empty() || params.recordWarmupMs > 0) && params.prefetchBytes > 0) {
+    // The prefetch doesn't keep the DB open, it stops if the DB closes first.
+    std::weak_ptr<DbHandle> weakHandle = handle;
+    std::vector<Warmup::Range> prefetch = params.prefetch;
+    bool replay = params.recordWarmupMs > 0;
+    size_t prefetchBytes = (size_t)params.prefetchBytes;
+    Async::run([weakHandle, prefetch, replay, sidecar, prefetchBytes]() mutable {
+      // A sidecar that can't be read is only a missed warmup, the next recording replaces it.
+      if (replay) {
+        Warmup::load(sidecar, &prefetch);
+      }
+      Warmup::prefetch(weakHandle, prefetch, prefetchBytes);
+    });
+  }
+}
+
+// Read-only DBs are checkpoints of their own, which aren't shared: see DbHandle::openCheckpoint().
+leveldb::Status openReadOnlyDb(const OpenParams& params, int* idx) {
+  Checkpoint::removeStaleTempPaths(params.path);
+  leveldb::Options options = params.options;
+  options.create_if_missing = false;
+  options.error_if_exists = false;
+  std::shared_ptr<const leveldb::FilterPolicy> filterPolicy = newFilterPolicy(params.bloomBitsPerKey,
+                                                                              params.sharedFilterPolicy);
+  options.filter_policy = filterPolicy.get();
+  std::shared_ptr<DbHandle> handle;
+  leveldb::Status status = DbHandle::openCheckpoint(params.path, Checkpoint::newTempPath(params.path), options,
+                                                    filterPolicy, params.profile, &handle);
+  if (!status.ok()) {
+    return status;
+  }
+  setUpOpenedDb(params, handle);
+  *idx = dbs.add(handle);
+  return status;
+}
+
+// Paths that openDb() is opening, with `openPathsMutex` released. Other opens of these paths wait on
+// `openingPathsCv` for the first one to finish, rather than failing on LevelDB's LOCK file.
+std::unordered_set<std::string> openingPaths;
+std::condition_variable openingPathsCv;
+
+// Takes a path out of `openingPaths` once its open is done, however it ends, e.g. by throwing: the opens waiting on
+// it would otherwise wait forever.
+class OpeningPath {
+ public:
+  explicit OpeningPath(std::string path) : path_(std::move(path)) {}
+  ~OpeningPath() {
+    {
+      std::lock_guard<std::mutex> lock(openPathsMutex);
+      openingPaths.erase(path_);
+    }
+    openingPathsCv.notify_all();
+  }
+  OpeningPath(const OpeningPath&) = delete;
+  OpeningPath& operator=(const OpeningPath&) = delete;
+
+ private:
+  const std::string path_;
+};
+
+// Opens the DB at `params.path`, or shares its handle if it's already open, e.g. by another runtime: LevelDB only
+// allows one DB per path. Sets `*idx` to the handle's index in `dbs`. Safe to call from any thread: the open, which
+// replays the log and so can take a while after an unclean shutdown, doesn't hold `openPathsMutex`.
+leveldb::Status openDb(const OpenParams& params, int* idx) {
+  const std::string& path = params.path;
+  if (params.readOnly) {
+    return openReadOnlyDb(params, idx);
+  }
+  {
+    std::unique_lock<std::mutex> lock(openPathsMutex);
+    openingPathsCv.wait(lock, [&]() { return openingPaths.count(path) == 0; });
+    auto openPath = openPaths.find(path);
+    if (openPath != openPaths.end()) {
+      if (params.options.error_if_exists) {
+        return leveldb::Status::InvalidArgument(path, "exists (error_if_exists is true)");
+      }
+      dbs.get(openPath->second)->openCount++;
+      *idx = openPath->second;
+      return leveldb::Status::OK();
+    }
+    openingPaths.insert(path);
+  }
+  OpeningPath opening(path);
+
+  leveldb::Options options = params.options;
+  std::shared_ptr<const leveldb::FilterPolicy> filterPolicy = newFilterPolicy(params.bloomBitsPerKey,
+                                                                              params.sharedFilterPolicy);
+  options.filter_policy = filterPolicy.get();
+  std::shared_ptr<DbHandle> handle;
+  leveldb::Status status = DbHandle::open(path, options, filterPolicy, params.profile, (size_t)params.blobThreshold,
+                                         &handle);
+  if (status.ok()) {
+    setUpOpenedDb(params, handle);
+  }
+
+  if (status.ok()) {
+    std::lock_guard<std::mutex> lock(openPathsMutex);
+    *idx = dbs.add(handle);
+    openPaths[path] = *idx;
+  }
+  return status;
+}
+
+void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir, std::shared_ptr<react::CallInvoker> jsCallInvoker) {
+  installedRuntimes++;
   if (documentDir[documentDir.length() - 1] != '/') {
     documentDir += '/';
   }
@@ -73,36 +744,37 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   auto leveldbOpen = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpen"),
-      3,  // db path, create_if_missing, error_if_exists
+      4,  // db path, create_if_missing, error_if_exists, options
       [documentDir](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        if (!arguments[0].isString() || !arguments[1].isBool() || !arguments[2].isBool()) {
-          throw jsi::JSError(runtime, "leveldbOpen/invalid-params");
-        }
-
-        leveldb::Options options;
-        std::string path = documentDir + arguments[0].getString(runtime).utf8(runtime);
-        options.create_if_missing = arguments[1].getBool();
-        options.error_if_exists = arguments[2].getBool();
-        options.compression = leveldb::CompressionType::kNoCompression;
-        options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-        options.reuse_logs = true;
-
-        leveldb::DB* db;
-        leveldb::Status status = leveldb::DB::Open(options, path, &db);
-
-        dbs.push_back(std::unique_ptr<leveldb::DB>{db});
-        int idx = (int)dbs.size() - 1;
-
+        OpenParams params = argumentsToOpenParams(runtime, documentDir, arguments, count, "leveldbOpen");
+        int idx;
+        leveldb::Status status = openDb(params, &idx);
         if (!status.ok()) {
-          dbs[idx].reset();
           throw jsi::JSError(runtime, "leveldbOpen/" + status.ToString());
         }
-
         return jsi::Value(idx);
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpen", std::move(leveldbOpen));
 
+  auto leveldbOpenAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpenAsync"),
+      4,  // db path, create_if_missing, error_if_exists, options
+      [documentDir, jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        OpenParams params = argumentsToOpenParams(runtime, documentDir, arguments, count, "leveldbOpenAsync");
+        return Async::promise(runtime, jsCallInvoker, [params]() {
+          int idx;
+          leveldb::Status status = openDb(params, &idx);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbOpenAsync/" + status.ToString());
+          }
+          return [idx](jsi::Runtime& runtime) { return jsi::Value(idx); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpenAsync", std::move(leveldbOpenAsync));
+
   auto leveldbDestroy = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbDestroy"),
@@ -118,6 +790,8 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
         if (!status.ok()) {
           throw jsi::JSError(runtime, "leveldbDestroy/" + status.ToString());
         }
+        remove(Warmup::sidecarPath(path).c_str());
+        Blob::destroy(path);
 
         return nullptr;
       }
@@ -133,11 +807,20 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
           throw jsi::JSError(runtime, "leveldbClose/invalid-params");
         }
         int idx = (int)arguments[0].getNumber();
-        if (idx < 0 || idx >= dbs.size() || !dbs[idx].get()) {
-          throw jsi::JSError(runtime, "leveldbClose/db-idx-out-of-bounds");
+        unwatchAll(runtime, idx);
+        // Destroyed outside of the lock, once the last in-flight call or iterator using the DB lets go of it.
+        std::shared_ptr<DbHandle> handle;
+        {
+          std::lock_guard<std::mutex> lock(openPathsMutex);
+          handle = dbs.get(idx);
+          if (!handle) {
+            throw jsi::JSError(runtime, "leveldbClose/db-idx-out-of-bounds");
+          }
+          if (--handle->openCount == 0) {
+            dbs.remove(idx);
+            openPaths.erase(handle->path);
+          }
         }
-
-        dbs[idx].reset();
         return nullptr;
       }
   );
@@ -149,7 +832,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
        2,  // dbs index, key
        [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
          std::string dbErr;
-         leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+         std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
          if (!db) {
            throw jsi::JSError(runtime, "leveldbGetStr/" + dbErr);
          }
@@ -159,7 +842,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
          }
 
          std::string value;
-         auto status = db->Get(leveldb::ReadOptions(), key, &value);
+         auto status = db->get(leveldb::ReadOptions(), key, &value);
          if (status.IsNotFound()) {
            return nullptr;
          } else if (!status.ok()) {
@@ -176,20 +859,23 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
      1,  // dbs index
      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
        std::string dbErr;
-       leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+       std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
        if (!db) {
          throw jsi::JSError(runtime, "leveldbGetAllStr/" + dbErr);
        }
        auto result = jsi::Object(runtime);
        
-       leveldb::Iterator* it = db->NewIterator(leveldb::ReadOptions());
+       leveldb::Iterator* it = db->newIterator(leveldb::ReadOptions());
        for (it->SeekToFirst(); it->Valid(); it->Next()) {
          auto key = jsi::String::createFromUtf8(runtime, it->key().ToString());
          auto value = jsi::String::createFromUtf8(runtime, it->value().ToString());
          result.setProperty(runtime, key, value);
        }
-       assert(it->status().ok());  // Check for any errors found during the scan
+       leveldb::Status status = it->status();
        delete it;
+       if (!status.ok()) {
+         throw jsi::JSError(runtime, "leveldbGetAllStr/" + status.ToString());
+       }
        return result;
      }
    );
@@ -199,17 +885,18 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   auto leveldbPut = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbPut"),
-      3,  // dbs index, key, value
+      5,  // dbs index, key, value, sync, ttlMs
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         std::string key;
         std::string dbErr;
-        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
         
         if (!db) {
           throw jsi::JSError(runtime, "leveldbPut/" + dbErr);
         }
           
-        if (!valueToString(runtime, arguments[1], &key)) {
+        std::string ttlHeader;
+        if (!valueToString(runtime, arguments[1], &key) || !argumentToTtlHeader(arguments, count, 4, &ttlHeader)) {
           throw jsi::JSError(runtime, "leveldbPut/invalid-params");
         }
 
@@ -225,7 +912,12 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
                 throw jsi::JSError(runtime, "leveldbPut/ an error occured encoding the data");
             }
 
-            auto status = db->Put(leveldb::WriteOptions(), key, leveldb::Slice(growable_buf, size));
+            leveldb::Slice value(growable_buf, size);
+            if (!ttlHeader.empty()) {
+              ttlHeader.append(growable_buf, size);
+              value = ttlHeader;
+            }
+            auto status = db->put(argumentToWriteOptions(*db, arguments, count, 3), key, value);
             if (!status.ok()) {
                 throw jsi::JSError(runtime, "leveldbPut/" + status.ToString());
             }
@@ -245,7 +937,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   auto leveldbBatchObjects = jsi::Function::createFromHostFunction(
     jsiRuntime,
     jsi::PropNameID::forAscii(jsiRuntime, "leveldbBatchObjects"),
-    3,  // dbs index, recordsToAdd, keysToDelete
+    5,  // dbs index, recordsToAdd, keysToDelete, sync, ttlMs
     [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
       
  
@@ -253,11 +945,16 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::Array keysToDelete = arguments[2].asObject(runtime).asArray(runtime);
       
       std::string dbErr;
-      leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+      std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
 
       if (!db) {
         throw jsi::JSError(runtime, "leveldbBatchObjects/" + dbErr);
       }
+      std::string ttlHeader;
+      if (!argumentToTtlHeader(arguments, count, 4, &ttlHeader)) {
+        throw jsi::JSError(runtime, "leveldbBatchObjects/invalid-params");
+      }
+      std::string value;
 
       leveldb::WriteBatch batch;
       auto names = record.getPropertyNames(runtime);
@@ -277,7 +974,12 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
                   throw jsi::JSError(runtime, "leveldbBatchObjects/ an error occurred encoding the data");
               }
 
-              batch.Put(key.utf8(runtime), leveldb::Slice(growable_buf, size));
+              if (ttlHeader.empty()) {
+                batch.Put(key.utf8(runtime), leveldb::Slice(growable_buf, size));
+              } else {
+                value.assign(ttlHeader).append(growable_buf, size);
+                batch.Put(key.utf8(runtime), value);
+              }
               MPACK_FREE(growable_buf);
           }
       } catch(...) {
@@ -288,15 +990,271 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       }
       
       auto keysToDeleteLength = keysToDelete.length(runtime);
+      std::string keyToDelete;
       for(size_t i = 0; i < keysToDeleteLength; i++) {
-        batch.Delete(keysToDelete.getValueAtIndex(runtime, i).asString(runtime).utf8(runtime));
+        if (!valueToString(runtime, keysToDelete.getValueAtIndex(runtime, i), &keyToDelete)) {
+          throw jsi::JSError(runtime, "leveldbBatchObjects/invalid-params");
+        }
+        batch.Delete(keyToDelete);
+      }
+      auto status = db->write(argumentToWriteOptions(*db, arguments, count, 3), &batch);
+      if (!status.ok()) {
+        throw jsi::JSError(runtime, "leveldbBatchObjects/" + status.ToString());
       }
-      db->Write(leveldb::WriteOptions(), &batch);
       return nullptr;
     }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbBatchObjects", std::move(leveldbBatchObjects));
+
+  auto leveldbBatchObjectsAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbBatchObjectsAsync"),
+      5,  // dbs index, recordsToAdd, keysToDelete, sync, ttlMs
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbBatchObjectsAsync/" + dbErr);
+        }
+        std::string ttlHeader;
+        if (count < 3 || !arguments[1].isObject() || !arguments[2].isObject() ||
+            !arguments[2].getObject(runtime).isArray(runtime) || !argumentToTtlHeader(arguments, count, 4, &ttlHeader)) {
+          throw jsi::JSError(runtime, "leveldbBatchObjectsAsync/invalid-params");
+        }
+        leveldb::WriteOptions options = argumentToWriteOptions(*db, arguments, count, 3);
+
+        // Only copying the values out of the runtime has to happen on the JS thread. Encoding them, building the batch
+        // and committing it happen on the worker pool.
+        jsi::Object record = arguments[1].getObject(runtime);
+        jsi::Array names = record.getPropertyNames(runtime);
+        auto entries = std::make_shared<std::vector<std::pair<std::string, Packer::Node>>>(names.length(runtime));
+        for (size_t i = 0; i < entries->size(); i++) {
+          jsi::String name = names.getValueAtIndex(runtime, i).getString(runtime);
+          (*entries)[i].first = name.utf8(runtime);
+          Packer::snapshot(record.getProperty(runtime, name), runtime, &(*entries)[i].second);
+        }
+        jsi::Array keysToDelete = arguments[2].getObject(runtime).getArray(runtime);
+        auto deletes = std::make_shared<std::vector<std::string>>(keysToDelete.length(runtime));
+        for (size_t i = 0; i < deletes->size(); i++) {
+          if (!valueToString(runtime, keysToDelete.getValueAtIndex(runtime, i), &(*deletes)[i])) {
+            throw jsi::JSError(runtime, "leveldbBatchObjectsAsync/invalid-params");
+          }
+        }
+
+        return Async::promise(runtime, jsCallInvoker, [db, options, ttlHeader, entries, deletes]() {
+          size_t chunks = (entries->size() + kParallelChunkEntries - 1) / kParallelChunkEntries;
+          std::vector<leveldb::WriteBatch> batches(chunks);
+          std::vector<char> failed(chunks, false);  // Not vector<bool>, the workers write to it concurrently.
+          Async::parallelFor(chunks, [&](size_t chunk) {
+            size_t end = std::min(entries->size(), (chunk + 1) * kParallelChunkEntries);
+            std::string value;
+            for (size_t i = chunk * kParallelChunkEntries; i < end; i++) {
+              mpack_writer_t writer;
+              char* buf = nullptr;
+              size_t size = 0;
+              mpack_writer_init_growable(&writer, &buf, &size);
+              Packer::pack((*entries)[i].second, &writer);
+              if (mpack_writer_destroy(&writer) != mpack_ok) {
+                MPACK_FREE(buf);
+                failed[chunk] = true;
+                return;
+              }
+              value.assign(ttlHeader).append(buf, size);
+              MPACK_FREE(buf);
+              batches[chunk].Put((*entries)[i].first, value);
+            }
+          });
+          if (std::find(failed.begin(), failed.end(), true) != failed.end()) {
+            throw std::runtime_error("leveldbBatchObjectsAsync/ an error occurred encoding the data");
+          }
+
+          leveldb::WriteBatch batch;
+          for (leveldb::WriteBatch& chunk : batches) {
+            batch.Append(chunk);
+          }
+          for (const std::string& key : *deletes) {
+            batch.Delete(key);
+          }
+          auto status = db->write(options, &batch);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbBatchObjectsAsync/" + status.ToString());
+          }
+          return [](jsi::Runtime& runtime) { return jsi::Value(); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbBatchObjectsAsync", std::move(leveldbBatchObjectsAsync));
+
+  auto leveldbPutMany = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbPutMany"),
+      6,  // dbs index, keys, values, offsets, sync, ttlMs
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbPutMany/" + dbErr);
+        }
+        std::string ttlHeader;
+        if (count < 3 || !arguments[1].isObject() || !arguments[1].getObject(runtime).isArray(runtime) ||
+            !arguments[2].isObject() || !argumentToTtlHeader(arguments, count, 5, &ttlHeader)) {
+          throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+        }
+        jsi::Array keys = arguments[1].getObject(runtime).getArray(runtime);
+        size_t length = keys.length(runtime);
+        // Converted before looking at the typed arrays: their bytes are only valid until JS runs again, which reading
+        // array elements may do (e.g. getters).
+        std::vector<std::string> keyStrings(length);
+        for (size_t i = 0; i < length; i++) {
+          if (!valueToString(runtime, keys.getValueAtIndex(runtime, i), &keyStrings[i])) {
+            throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+          }
+        }
+
+        // The values are either an array of values to encode, a Float64Array of numbers, or a Uint8Array of raw
+        // values, the i-th one being the bytes in [offsets[i], offsets[i + 1]).
+        jsi::Object values = arguments[2].getObject(runtime);
+        const uint8_t *numbers = nullptr, *bytes = nullptr, *offsetBytes = nullptr;
+        size_t numbersSize = 0, bytesSize = 0, offsetsSize = 0;
+        if (values.isArray(runtime)) {
+          if (values.getArray(runtime).length(runtime) != length) {
+            throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+          }
+        } else if (typedArrayBytes(runtime, arguments[2], "Float64Array", &numbers, &numbersSize)) {
+          if (numbersSize != length * sizeof(double)) {
+            throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+          }
+        } else if (typedArrayBytes(runtime, arguments[2], "Uint8Array", &bytes, &bytesSize)) {
+          // Raw values are read back as they are, which a TTL header would be part of.
+          if (count < 4 || !typedArrayBytes(runtime, arguments[3], "Uint32Array", &offsetBytes, &offsetsSize) ||
+              offsetsSize != (length + 1) * sizeof(uint32_t) || !ttlHeader.empty()) {
+            throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+          }
+        } else {
+          throw jsi::JSError(runtime, "leveldbPutMany/invalid-params");
+        }
+
+
+        leveldb::WriteBatch batch;
+        std::string value;
+        jsi::Array valueArray = numbers || bytes ? jsi::Array(runtime, 0) : values.getArray(runtime);
+        for (size_t i = 0; i < length; i++) {
+          value.assign(ttlHeader);
+          if (numbers) {
+            // Encoded like put() encodes numbers.
+            double number;
+            memcpy(&number, numbers + i * sizeof(double), sizeof(double));
+            char encoded[9];
+            mpack_writer_t writer;
+            mpack_writer_init(&writer, encoded, sizeof(encoded));
+            mpack_write_double(&writer, number);
+            value.append(encoded, mpack_writer_buffer_used(&writer));
+            mpack_writer_destroy(&writer);
+          } else if (bytes) {
+            uint32_t begin, end;
+            memcpy(&begin, offsetBytes + i * sizeof(uint32_t), sizeof(uint32_t));
+            memcpy(&end, offsetBytes + (i + 1) * sizeof(uint32_t), sizeof(uint32_t));
+            if (begin > end || end > bytesSize) {
+              throw jsi::JSError(runtime, "leveldbPutMany/invalid-offsets");
+            }
+            if (isReservedRawValue((const char*)bytes + begin, end - begin)) {
+              throw jsi::JSError(runtime, "leveldbPutMany/reserved-raw-value");
+            }
+            value.append((const char*)bytes + begin, end - begin);
+          } else {
+            packValue(runtime, valueArray.getValueAtIndex(runtime, i), "leveldbPutMany", &value);
+          }
+          batch.Put(keyStrings[i], value);
+        }
+
+        auto status = db->write(argumentToWriteOptions(*db, arguments, count, 4), &batch);
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbPutMany/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbPutMany", std::move(leveldbPutMany));
+
+  auto leveldbNewWriteBatch = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbNewWriteBatch"),
+      0,
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        return jsi::Object::createFromHostObject(runtime, std::make_shared<WriteBatchHostObject>());
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbNewWriteBatch", std::move(leveldbNewWriteBatch));
+
+  auto leveldbWrite = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbWrite"),
+      3,  // dbs index, batch, sync
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbWrite/" + dbErr);
+        }
+        if (count < 2 || !arguments[1].isObject() ||
+            !arguments[1].getObject(runtime).isHostObject<WriteBatchHostObject>(runtime)) {
+          throw jsi::JSError(runtime, "leveldbWrite/invalid-params");
+        }
+        std::shared_ptr<RangeWriteBatch> batch =
+            arguments[1].getObject(runtime).getHostObject<WriteBatchHostObject>(runtime)->batch_;
+        auto status = batch->commit(*db, argumentToWriteOptions(*db, arguments, count, 2));
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbWrite/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbWrite", std::move(leveldbWrite));
   
+  auto leveldbSetWriteCoalescing = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbSetWriteCoalescing"),
+      3,  // dbs index, maxBytes (0 disables coalescing), maxDelayMs
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbSetWriteCoalescing/" + dbErr);
+        }
+        if (!arguments[1].isNumber() || !arguments[2].isNumber()
+            || arguments[1].getNumber() < 0 || arguments[2].getNumber() < 0) {
+          throw jsi::JSError(runtime, "leveldbSetWriteCoalescing/invalid-params");
+        }
+
+        auto status = db->setCoalescing((size_t)arguments[1].getNumber(), (int)arguments[2].getNumber());
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbSetWriteCoalescing/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbSetWriteCoalescing", std::move(leveldbSetWriteCoalescing));
+
+  auto leveldbFlush = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbFlush"),
+      2,  // dbs index, sync
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbFlush/" + dbErr);
+        }
+
+        auto status = db->flush(count > 1 && arguments[1].isBool() ? arguments[1].getBool() : db->syncByDefault.load());
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbFlush/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbFlush", std::move(leveldbFlush));
+
   auto leveldbClear = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbClear"),
@@ -304,20 +1262,24 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         
         std::string dbErr;
-        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
         if (!db) {
           throw jsi::JSError(runtime, "leveldbClear/" + dbErr);
         }
         
         leveldb::WriteBatch batch;
-        leveldb::Iterator* it = db->NewIterator(leveldb::ReadOptions());
+        leveldb::Iterator* it = db->newIterator(leveldb::ReadOptions());
         for (it->SeekToFirst(); it->Valid(); it->Next()) {
           batch.Delete(it->key());
         }
-        assert(it->status().ok());  // Check for any errors found during the scan
+        auto status = it->status();
         delete it;
-        
-        db->Write(leveldb::WriteOptions(), &batch);
+        if (status.ok()) {
+          status = db->write(db->writeOptions(), &batch);
+        }
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbClear/" + status.ToString());
+        }
         return nullptr;
       }
   );
@@ -327,11 +1289,11 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   auto leveldbDelete = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbDelete"),
-      2,  // dbs index, key
+      3,  // dbs index, key, sync
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         std::string key;
         std::string dbErr;
-        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
         if (!db) {
           throw jsi::JSError(runtime, "leveldbDelete/" + dbErr);
         }
@@ -339,7 +1301,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
           throw jsi::JSError(runtime, "leveldbDelete/invalid-params");
         }
 
-        auto status = db->Delete(leveldb::WriteOptions(), key);
+        auto status = db->del(argumentToWriteOptions(*db, arguments, count, 2), key);
 
         if (status.ok() || status.IsNotFound()) {
           return nullptr;
@@ -350,18 +1312,196 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbDelete", std::move(leveldbDelete));
 
+  auto leveldbUpdate = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbUpdate"),
+      4,  // dbs index, key, op, sync
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbUpdate/" + dbErr);
+        }
+        std::string key;
+        if (count < 3 || !valueToString(runtime, arguments[1], &key) || !arguments[2].isObject()) {
+          throw jsi::JSError(runtime, "leveldbUpdate/invalid-params");
+        }
+        // Exactly one of the operations.
+        jsi::Object op = arguments[2].getObject(runtime);
+        const char* name = nullptr;
+        jsi::Value operand;
+        for (const char* candidate : {"set", "inc", "push", "merge"}) {
+          jsi::Value value = op.getProperty(runtime, candidate);
+          if (value.isUndefined()) {
+            continue;
+          }
+          if (name) {
+            throw jsi::JSError(runtime, "leveldbUpdate/invalid-params");
+          }
+          name = candidate;
+          operand = std::move(value);
+        }
+        std::string opName = name ? name : "";
+        if (opName.empty() || (opName == "inc" && !operand.isNumber()) ||
+            (opName == "merge" && (!operand.isObject() || operand.getObject(runtime).isArray(runtime)))) {
+          throw jsi::JSError(runtime, "leveldbUpdate/invalid-params");
+        }
+
+        // Copied out of the runtime before taking the write lock: reading the operand may run JS (getters, proxies),
+        // which may write to this DB. Under the lock, the update only works on native data.
+        Packer::Node operandNode;
+        if (opName != "inc") {
+          Packer::snapshot(operand, runtime, &operandNode);
+        }
+        double increment = opName == "inc" ? operand.getNumber() : 0;
+
+        Packer::Node result;
+        // Set instead of throwing from under the lock.
+        std::string error;
+        auto status = db->update(argumentToWriteOptions(*db, arguments, count, 3), [&](leveldb::WriteBatch* batch) {
+          std::string stored;
+          leveldb::Status status = db->get(leveldb::ReadOptions(), key, &stored);
+          if (!status.ok() && !status.IsNotFound()) {
+            return status;
+          }
+          // The TTL of the value, if any, is kept. Expired values count as missing, and so do undefined ones.
+          std::string updated;
+          leveldb::Slice value;
+          Packer::Node current;
+          current.type = Packer::Node::kUndefined;
+          if (status.ok() && splitTtlHeader(stored, &updated, &value) &&
+              !Packer::parse(value.data(), value.size(), &current)) {
+            error = "malformed-value";
+            return leveldb::Status::Corruption(key);
+          }
+          bool missing = current.type == Packer::Node::kUndefined;
+
+          if (opName == "set") {
+            result = operandNode;
+          } else if (opName == "inc") {
+            if (!missing && current.type != Packer::Node::kNumber) {
+              error = "not-a-number";
+              return leveldb::Status::InvalidArgument(key);
+            }
+            result.type = Packer::Node::kNumber;
+            result.number = (missing ? 0 : current.number) + increment;
+          } else if (opName == "push") {
+            if (!missing && current.type != Packer::Node::kArray) {
+              error = "not-an-array";
+              return leveldb::Status::InvalidArgument(key);
+            }
+            result = std::move(current);
+            result.type = Packer::Node::kArray;
+            result.children.push_back(operandNode);
+          } else {
+            if (!missing && current.type != Packer::Node::kMap) {
+              error = "not-an-object";
+              return leveldb::Status::InvalidArgument(key);
+            }
+            result = std::move(current);
+            result.type = Packer::Node::kMap;
+            // Like assigning the properties of the patch one by one: existing ones keep their place.
+            for (size_t i = 0; i < operandNode.keys.size(); i++) {
+              auto existing = std::find(result.keys.begin(), result.keys.end(), operandNode.keys[i]);
+              if (existing != result.keys.end()) {
+                result.children[existing - result.keys.begin()] = operandNode.children[i];
+              } else {
+                result.keys.push_back(operandNode.keys[i]);
+                result.children.push_back(operandNode.children[i]);
+              }
+            }
+          }
+
+          if (!packNode(result, &updated)) {
+            error = "encoding-failed";
+            return leveldb::Status::InvalidArgument(key);
+          }
+          batch->Put(key, updated);
+          return leveldb::Status::OK();
+        });
+        if (!error.empty()) {
+          throw jsi::JSError(runtime, "leveldbUpdate/" + error);
+        }
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbUpdate/" + status.ToString());
+        }
+        return Packer::toValue(runtime, result);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbUpdate", std::move(leveldbUpdate));
+
+  auto leveldbCas = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbCas"),
+      5,  // dbs index, key, expected, value, sync
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbCas/" + dbErr);
+        }
+        std::string key;
+        if (count < 4 || !valueToString(runtime, arguments[1], &key)) {
+          throw jsi::JSError(runtime, "leveldbCas/invalid-params");
+        }
+        // Values are compared by their encoding. undefined stands for a missing value, on either side.
+        bool expectMissing = arguments[2].isUndefined();
+        std::string expected;
+        if (!expectMissing) {
+          packValue(runtime, arguments[2], "leveldbCas", &expected);
+        }
+        bool remove = arguments[3].isUndefined();
+        std::string value;
+        if (!remove) {
+          packValue(runtime, arguments[3], "leveldbCas", &value);
+        }
+
+        bool swapped = false;
+        auto status = db->update(argumentToWriteOptions(*db, arguments, count, 4), [&](leveldb::WriteBatch* batch) {
+          std::string stored;
+          leveldb::Status status = db->get(leveldb::ReadOptions(), key, &stored);
+          if (!status.ok() && !status.IsNotFound()) {
+            return status;
+          }
+          std::string header;
+          leveldb::Slice current;
+          bool missing = !status.ok() || !splitTtlHeader(stored, &header, &current);
+          if (missing ? !expectMissing : (expectMissing || current != leveldb::Slice(expected))) {
+            return leveldb::Status::OK();
+          }
+          // A swapped in value doesn't inherit the TTL of the one it replaces.
+          if (remove) {
+            batch->Delete(key);
+          } else {
+            batch->Put(key, value);
+          }
+          swapped = true;
+          return leveldb::Status::OK();
+        });
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbCas/" + status.ToString());
+        }
+        return swapped;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbCas", std::move(leveldbCas));
+
   auto leveldbNewIterator = jsi::Function::createFromHostFunction(
       jsiRuntime,
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbNewIterator"),
       1,  // index into dbs vector
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         std::string dbErr;
-        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
         if (!db) {
           throw jsi::JSError(runtime, "leveldbNewIterator/" + dbErr);
         }
-        iterators.push_back(std::unique_ptr<leveldb::Iterator>{db->NewIterator(leveldb::ReadOptions())});
-        return jsi::Value((int)iterators.size() - 1);
+        std::unique_ptr<leveldb::Iterator> it(db->newIterator(leveldb::ReadOptions()));
+        // E.g. if the staged writes couldn't be committed.
+        if (!it->status().ok()) {
+          throw jsi::JSError(runtime, "leveldbNewIterator/" + it->status().ToString());
+        }
+        return jsi::Value(iterators.add(std::make_shared<IteratorHandle>(it.release())));
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbNewIterator", std::move(leveldbNewIterator));
@@ -371,7 +1511,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorSeekToFirst"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorSeekToFirst/invalid-params");
         }
@@ -386,7 +1526,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorSeekToLast"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorSeekToLast/invalid-params");
         }
@@ -401,7 +1541,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorSeek"),
       2,  // iterators index, seek target
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorSeek/invalid-params");
         }
@@ -421,7 +1561,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorValid"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorValid/invalid-params");
         }
@@ -435,7 +1575,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorPrev"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorPrev/invalid-params");
         }
@@ -450,7 +1590,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorNext"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorNext/invalid-params");
         }
@@ -465,11 +1605,11 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorDelete"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorDelete/invalid-params");
         }
-        iterators[(int)arguments[0].getNumber()].reset();
+        iterators.remove((int)arguments[0].getNumber());
         return nullptr;
       }
   );
@@ -480,7 +1620,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorKeyStr"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorKeyStr/invalid-params");
         }
@@ -494,7 +1634,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorValueStr"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorValueStr/invalid-params");
         }
@@ -509,7 +1649,7 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       2,  // dbs index, key
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         std::string dbErr;
-        leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
         if (!db) {
           throw jsi::JSError(runtime, "leveldbGet/" + dbErr);
         }
@@ -519,30 +1659,19 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
         }
         std::string value;
 
-        auto status = db->Get(leveldb::ReadOptions(), key, &value);
+        auto status = db->get(leveldb::ReadOptions(), key, &value);
 
         if (status.IsNotFound()) {
           return nullptr;
         } else if (!status.ok()) {
           throw jsi::JSError(runtime, "leveldbGet/" + status.ToString());
         }
-          
-        mpack_reader_t reader;
-        jsi::Value parsed;
-
-        try {
-            mpack_reader_init_data(&reader, value.data(), value.size());
-            parsed = Packer::unpackElement(runtime, &reader, 0);
-        } catch(...) {
-            mpack_reader_destroy(&reader);
-            throw;
-        }
 
-        if(mpack_ok != mpack_reader_destroy(&reader)) {
-            throw jsi::JSError(runtime, "leveldbGet/ failed to read data");
+        leveldb::Slice live(value);
+        if (!Ttl::live(&live, Ttl::now())) {
+          return nullptr;
         }
-                    
-        return parsed;
+        return unpackValue(runtime, live, "leveldbGet");
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbGet", std::move(leveldbGet));
@@ -553,40 +1682,262 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
    1,  // dbs index
    [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
      std::string dbErr;
-     leveldb::DB* db = valueToDb(arguments[0], &dbErr);
+     std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
      if (!db) {
        throw jsi::JSError(runtime, "leveldbGetAllObjects/" + dbErr);
      }
      auto result = jsi::Object(runtime);
 
-     leveldb::Iterator* it = db->NewIterator(leveldb::ReadOptions());
-     
-     mpack_reader_t reader;
-
-     try {
-         for (it->SeekToFirst(); it->Valid(); it->Next()) {
-             auto key = jsi::String::createFromUtf8(runtime, it->key().ToString());
-             auto value = it->value();
-
-             mpack_reader_init_data(&reader, value.data(), value.size());
-             auto parsed = Packer::unpackElement(runtime, &reader, 0);
-
-             if (mpack_ok != mpack_reader_destroy(&reader)) {
-                 throw jsi::JSError(runtime, "leveldbGetAllObjects/ failed to read data");
-             }
-
-             result.setProperty(runtime, key, parsed);
+     db->warmupRecorder.recordRange(nullptr, nullptr);
+     std::unique_ptr<leveldb::Iterator> it(db->newIterator(leveldb::ReadOptions()));
+     int64_t now = Ttl::now();
+     for (it->SeekToFirst(); it->Valid(); it->Next()) {
+         leveldb::Slice value = it->value();
+         if (!Ttl::live(&value, now)) {
+             continue;
          }
-     }catch(...) {
-         mpack_reader_destroy(&reader);
-         throw;
+         auto key = jsi::String::createFromUtf8(runtime, it->key().ToString());
+         result.setProperty(runtime, key, unpackValue(runtime, value, "leveldbGetAllObjects"));
+     }
+     if (!it->status().ok()) {
+       throw jsi::JSError(runtime, "leveldbGetAllObjects/" + it->status().ToString());
      }
-     assert(it->status().ok());  // Check for any errors found during the scan
-     delete it;
      return result;
    }
  );
  jsiRuntime.global().setProperty(jsiRuntime, "leveldbGetAllObjects", std::move(leveldbGetAllObjects));
+
+  auto leveldbGetAllObjectsAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbGetAllObjectsAsync"),
+      3,  // dbs index, gte, lt
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbGetAllObjectsAsync/" + dbErr);
+        }
+        std::shared_ptr<std::string> gte, lt;
+        if (!argumentToOptionalString(runtime, arguments, count, 1, &gte) ||
+            !argumentToOptionalString(runtime, arguments, count, 2, &lt)) {
+          throw jsi::JSError(runtime, "leveldbGetAllObjectsAsync/invalid-params");
+        }
+        db->warmupRecorder.recordRange(gte.get(), lt.get());
+
+        // Reading and decoding happen on the worker pool, into native trees that the JS thread only has to turn into
+        // JS values.
+        return Async::promise(runtime, jsCallInvoker, [db, gte, lt]() {
+          auto keys = std::make_shared<std::vector<std::string>>();
+          std::vector<std::string> values;
+          std::unique_ptr<leveldb::Iterator> it(db->newIterator(leveldb::ReadOptions()));
+          int64_t now = Ttl::now();
+          for (gte ? it->Seek(*gte) : it->SeekToFirst(); it->Valid(); it->Next()) {
+            if (lt && db->comparator()->Compare(it->key(), *lt) >= 0) {
+              break;
+            }
+            leveldb::Slice value = it->value();
+            if (!Ttl::live(&value, now)) {
+              continue;
+            }
+            keys->push_back(it->key().ToString());
+            values.push_back(value.ToString());
+          }
+          if (!it->status().ok()) {
+            throw std::runtime_error("leveldbGetAllObjectsAsync/" + it->status().ToString());
+          }
+          it.reset();
+
+          auto nodes = std::make_shared<std::vector<Packer::Node>>(values.size());
+          size_t chunks = (values.size() + kParallelChunkEntries - 1) / kParallelChunkEntries;
+          std::vector<char> failed(chunks, false);  // Not vector<bool>, the workers write to it concurrently.
+          Async::parallelFor(chunks, [&](size_t chunk) {
+            size_t end = std::min(values.size(), (chunk + 1) * kParallelChunkEntries);
+            for (size_t i = chunk * kParallelChunkEntries; i < end; i++) {
+              if (!Packer::parse(values[i].data(), values[i].size(), &(*nodes)[i])) {
+                failed[chunk] = true;
+                return;
+              }
+            }
+          });
+          if (std::find(failed.begin(), failed.end(), true) != failed.end()) {
+            throw std::runtime_error("leveldbGetAllObjectsAsync/ failed to read data");
+          }
+
+          return [keys, nodes](jsi::Runtime& runtime) -> jsi::Value {
+            jsi::Object result(runtime);
+            for (size_t i = 0; i < keys->size(); i++) {
+              result.setProperty(runtime, jsi::String::createFromUtf8(runtime, (*keys)[i]),
+                                 Packer::toValue(runtime, (*nodes)[i]));
+            }
+            return result;
+          };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbGetAllObjectsAsync", std::move(leveldbGetAllObjectsAsync));
+
+  auto leveldbScanPrefix = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbScanPrefix"),
+      5,  // dbs index, prefix, limit, reverse, keys
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbScanPrefix/" + dbErr);
+        }
+        std::string prefix;
+        KeyFormat keys;
+        if (count < 5 || !valueToString(runtime, arguments[1], &prefix) || !arguments[2].isNumber() ||
+            arguments[2].getNumber() < 0 || !arguments[3].isBool() || !valueToKeyFormat(runtime, arguments[4], &keys)) {
+          throw jsi::JSError(runtime, "leveldbScanPrefix/invalid-params");
+        }
+        // Only bytewise order keeps the keys that share a prefix next to each other, and the successor of the prefix
+        // after them.
+        if (db->comparator() != leveldb::BytewiseComparator()) {
+          throw jsi::JSError(runtime, "leveldbScanPrefix/unsupported-comparator");
+        }
+        double limit = arguments[2].getNumber();
+        bool reverse = arguments[3].getBool();
+
+        std::string successor = prefixSuccessor(prefix);
+        db->warmupRecorder.recordRange(&prefix, successor.empty() ? nullptr : &successor);
+        std::unique_ptr<leveldb::Iterator> it(db->newIterator(leveldb::ReadOptions()));
+        if (!reverse) {
+          it->Seek(prefix);
+        } else {
+          if (successor.empty()) {
+            it->SeekToLast();
+          } else {
+            it->Seek(successor);
+            if (it->Valid()) {
+              it->Prev();
+            } else {
+              it->SeekToLast();
+            }
+          }
+        }
+
+        std::vector<jsi::Value> entries;
+        int64_t now = Ttl::now();
+        for (; it->Valid() && entries.size() < limit && it->key().starts_with(prefix);
+             reverse ? it->Prev() : it->Next()) {
+          leveldb::Slice value = it->value();
+          if (!Ttl::live(&value, now)) {
+            continue;
+          }
+          jsi::Array entry(runtime, 2);
+          entry.setValueAtIndex(runtime, 0, keyToValue(runtime, it->key(), keys));
+          entry.setValueAtIndex(runtime, 1, unpackValue(runtime, value, "leveldbScanPrefix"));
+          entries.push_back(std::move(entry));
+        }
+        if (!it->status().ok()) {
+          throw jsi::JSError(runtime, "leveldbScanPrefix/" + it->status().ToString());
+        }
+
+        jsi::Array result(runtime, entries.size());
+        for (size_t i = 0; i < entries.size(); i++) {
+          result.setValueAtIndex(runtime, i, std::move(entries[i]));
+        }
+        return result;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbScanPrefix", std::move(leveldbScanPrefix));
+
+  auto leveldbWatch = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbWatch"),
+      5,  // dbs index, gte, lt, keys, callback
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbWatch/" + dbErr);
+        }
+        std::shared_ptr<std::string> gte, lt;
+        KeyFormat keys;
+        if (count < 5 || !argumentToOptionalString(runtime, arguments, count, 1, &gte) ||
+            !argumentToOptionalString(runtime, arguments, count, 2, &lt) ||
+            !valueToKeyFormat(runtime, arguments[3], &keys) || !arguments[4].isObject() ||
+            !arguments[4].getObject(runtime).isFunction(runtime)) {
+          throw jsi::JSError(runtime, "leveldbWatch/invalid-params");
+        }
+        auto callback = Async::share(runtime, jsCallInvoker, arguments[4]);
+        std::weak_ptr<DbHandle> weakDb = db;
+
+        // Called by the first write since the last delivery: the keys changed until the JS thread gets to it are
+        // delivered together.
+        int id = db->watchers.add(gte.get(), lt.get(), [&runtime, jsCallInvoker, weakDb, keys, callback](int id) {
+          jsCallInvoker->invokeAsync([&runtime, weakDb, id, keys, callback]() {
+            std::shared_ptr<DbHandle> db = weakDb.lock();
+            if (!db) {
+              return;
+            }
+            // Empty if unwatched meanwhile.
+            std::vector<std::string> changed = db->watchers.take(id);
+            if (changed.empty()) {
+              return;
+            }
+            jsi::Array array(runtime, changed.size());
+            for (size_t i = 0; i < changed.size(); i++) {
+              // There's no caller to throw to: keys that aren't tuples are delivered as they are.
+              try {
+                array.setValueAtIndex(runtime, i, keyToValue(runtime, changed[i], keys));
+              } catch (const jsi::JSError&) {
+                array.setValueAtIndex(runtime, i, keyToValue(runtime, changed[i], KeyFormat::kBuffer));
+              }
+            }
+            callback->asObject(runtime).asFunction(runtime).call(runtime, std::move(array));
+          });
+        });
+        {
+          std::lock_guard<std::mutex> lock(runtimeWatchesMutex);
+          runtimeWatches[&runtime][(int)arguments[0].getNumber()].insert(id);
+        }
+        return id;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbWatch", std::move(leveldbWatch));
+
+  auto leveldbUnwatch = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbUnwatch"),
+      2,  // dbs index, watch id
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        if (count < 2 || !arguments[1].isNumber()) {
+          throw jsi::JSError(runtime, "leveldbUnwatch/invalid-params");
+        }
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          // The watch went away with the DB.
+          if (dbErr == "valueToDb/db-closed") {
+            return false;
+          }
+          throw jsi::JSError(runtime, "leveldbUnwatch/" + dbErr);
+        }
+        int idx = (int)arguments[0].getNumber();
+        int id = (int)arguments[1].getNumber();
+        {
+          std::lock_guard<std::mutex> lock(runtimeWatchesMutex);
+          auto watches = runtimeWatches.find(&runtime);
+          if (watches != runtimeWatches.end()) {
+            auto ids = watches->second.find(idx);
+            if (ids != watches->second.end()) {
+              ids->second.erase(id);
+              if (ids->second.empty()) {
+                watches->second.erase(ids);
+              }
+            }
+            if (watches->second.empty()) {
+              runtimeWatches.erase(watches);
+            }
+          }
+        }
+        return db->watchers.remove(id);
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbUnwatch", std::move(leveldbUnwatch));
     
     
   auto leveldbIteratorKeyBuf = jsi::Function::createFromHostFunction(
@@ -594,17 +1945,12 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorKeyBuf"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorKeyBuf/invalid-params");
         }
-        std::string key = iterator->key().ToString();
-
-        jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
-        jsi::Object o = arrayBufferCtor.callAsConstructor(runtime, (int)key.length()).getObject(runtime);
-        jsi::ArrayBuffer buf = o.getArrayBuffer(runtime);
-        memcpy(buf.data(runtime), key.c_str(), key.size());
-        return o;
+        leveldb::Slice key = iterator->key();
+        return newArrayBuffer(runtime, key.data(), key.size());
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbIteratorKeyBuf", std::move(leveldbIteratorKeyBuf));
@@ -614,17 +1960,12 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       jsi::PropNameID::forAscii(jsiRuntime, "leveldbIteratorValueBuf"),
       1,  // iterators index
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
-        leveldb::Iterator* iterator = valueToIterator(arguments[0]);
+        std::shared_ptr<leveldb::Iterator> iterator = valueToIterator(arguments[0]);
         if (!iterator) {
           throw jsi::JSError(runtime, "leveldbIteratorValueBuf/invalid-params");
         }
-        std::string value = iterator->value().ToString();
-
-        jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
-        jsi::Object o = arrayBufferCtor.callAsConstructor(runtime, (int)value.length()).getObject(runtime);
-        jsi::ArrayBuffer buf = o.getArrayBuffer(runtime);
-        memcpy(buf.data(runtime), value.c_str(), value.size());
-        return o;
+        leveldb::Slice value = iterator->value();
+        return newArrayBuffer(runtime, value.data(), value.size());
       }
   );
   jsiRuntime.global().setProperty(jsiRuntime, "leveldbIteratorValueBuf", std::move(leveldbIteratorValueBuf));
@@ -646,11 +1987,11 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
       3,  // dbs index dest, dbs index src, batchBool
       [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
         std::string dbErr;
-        leveldb::DB* dbDst = valueToDb(arguments[0], &dbErr);
+        std::shared_ptr<DbHandle> dbDst = valueToDb(arguments[0], &dbErr);
         if (!dbDst) {
           throw jsi::JSError(runtime, "leveldbMerge/dst/" + dbErr);
         }
-        leveldb::DB* dbSrc = valueToDb(arguments[1], &dbErr);
+        std::shared_ptr<DbHandle> dbSrc = valueToDb(arguments[1], &dbErr);
         if (!dbSrc) {
           throw jsi::JSError(runtime, "leveldbMerge/src/" + dbErr);
         }
@@ -659,28 +2000,222 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
         }
         bool batchMerge = (bool)arguments[2].getBool();
 
-        leveldb::WriteBatch batch;
-        std::unique_ptr<leveldb::Iterator> itSrc(dbSrc->NewIterator(leveldb::ReadOptions()));
-        for (itSrc->SeekToFirst(); itSrc->Valid(); itSrc->Next()) {
-          if (batchMerge) {
-            batch.Put(itSrc->key(), itSrc->value());
-          } else {
-            dbDst->Put(leveldb::WriteOptions(), itSrc->key(), itSrc->value());
+        // A batchMerge is committed as a single batch, so that it's atomic.
+        auto status = mergeInChunks(*dbDst, *dbSrc, batchMerge ? SIZE_MAX : kMergeChunkBytes, nullptr);
+        if (!status.ok()) {
+          throw jsi::JSError(runtime, "leveldbMerge/" + status.ToString());
+        }
+        return nullptr;
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbMerge", std::move(leveldbMerge));
+
+  auto leveldbMergeAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbMergeAsync"),
+      4,  // dbs index dest, dbs index src, chunkBytes, onProgress
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> dbDst = valueToDb(arguments[0], &dbErr);
+        if (!dbDst) {
+          throw jsi::JSError(runtime, "leveldbMergeAsync/dst/" + dbErr);
+        }
+        std::shared_ptr<DbHandle> dbSrc = valueToDb(arguments[1], &dbErr);
+        if (!dbSrc) {
+          throw jsi::JSError(runtime, "leveldbMergeAsync/src/" + dbErr);
+        }
+        if (!arguments[2].isNumber() || arguments[2].getNumber() <= 0) {
+          throw jsi::JSError(runtime, "leveldbMergeAsync/invalid-params");
+        }
+        size_t chunkBytes = (size_t)arguments[2].getNumber();
+        auto onProgress = Async::share(runtime, jsCallInvoker, arguments[3]);
+
+        return Async::promise(runtime, jsCallInvoker, [&runtime, jsCallInvoker, dbDst, dbSrc, chunkBytes, onProgress]() {
+          uint64_t merged = 0;
+          auto status = mergeInChunks(*dbDst, *dbSrc, chunkBytes, [&](uint64_t entries, double fraction) {
+            merged = entries;
+            Async::callLater(runtime, jsCallInvoker, onProgress, [entries, fraction](jsi::Runtime& runtime) {
+              std::vector<jsi::Value> args;
+              args.emplace_back((double)entries);
+              args.emplace_back(fraction);
+              return args;
+            });
+          });
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbMergeAsync/" + status.ToString());
           }
+          return [merged](jsi::Runtime& runtime) { return jsi::Value((double)merged); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbMergeAsync", std::move(leveldbMergeAsync));
+
+  auto leveldbSetProfileAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbSetProfileAsync"),
+      3,  // dbs index, profile, compact
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbSetProfileAsync/" + dbErr);
         }
+        DbProfile profile;
+        if (!valueToProfile(runtime, arguments[1], &profile)) {
+          throw jsi::JSError(runtime, "leveldbSetProfileAsync/invalid-params");
+        }
+        bool compact = count > 2 && arguments[2].isBool() && arguments[2].getBool();
 
-        if (!itSrc->status().ok()) {
-          throw jsi::JSError(runtime, "leveldbMerge/" + itSrc->status().ToString());
+        // Reopening waits for in-flight calls on the DB, and compacting can take a while: keep both off the JS thread.
+        return Async::promise(runtime, jsCallInvoker, [db, profile, compact]() {
+          auto status = db->setProfile(profile, compact);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbSetProfileAsync/" + status.ToString());
+          }
+          return [](jsi::Runtime& runtime) { return jsi::Value(); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbSetProfileAsync", std::move(leveldbSetProfileAsync));
+
+  auto leveldbSweepExpiredAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbSweepExpiredAsync"),
+      2,  // dbs index, chunkBytes
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbSweepExpiredAsync/" + dbErr);
         }
+        if (count < 2 || !arguments[1].isNumber() || arguments[1].getNumber() < 1) {
+          throw jsi::JSError(runtime, "leveldbSweepExpiredAsync/invalid-params");
+        }
+        size_t chunkBytes = (size_t)arguments[1].getNumber();
 
-        if (batchMerge) {
-          dbDst->Write(leveldb::WriteOptions(), &batch);
+        return Async::promise(runtime, jsCallInvoker, [db, chunkBytes]() {
+          uint64_t deleted;
+          auto status = Ttl::sweep(*db, chunkBytes, &deleted);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbSweepExpiredAsync/" + status.ToString());
+          }
+          return [deleted](jsi::Runtime& runtime) { return jsi::Value((double)deleted); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbSweepExpiredAsync", std::move(leveldbSweepExpiredAsync));
+
+  auto leveldbCollectBlobGarbageAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbCollectBlobGarbageAsync"),
+      2,  // dbs index, minGarbageRatio
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbCollectBlobGarbageAsync/" + dbErr);
         }
+        if (count < 2 || !arguments[1].isNumber() || !(arguments[1].getNumber() > 0) ||
+            arguments[1].getNumber() > 1) {
+          throw jsi::JSError(runtime, "leveldbCollectBlobGarbageAsync/invalid-params");
+        }
+        double minGarbageRatio = arguments[1].getNumber();
 
-        return nullptr;
+        return Async::promise(runtime, jsCallInvoker, [db, minGarbageRatio]() {
+          uint64_t reclaimed;
+          auto status = db->collectBlobGarbage(minGarbageRatio, &reclaimed);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbCollectBlobGarbageAsync/" + status.ToString());
+          }
+          return [reclaimed](jsi::Runtime& runtime) { return jsi::Value((double)reclaimed); };
+        });
       }
   );
-  jsiRuntime.global().setProperty(jsiRuntime, "leveldbMerge", std::move(leveldbMerge));
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbCollectBlobGarbageAsync", std::move(leveldbCollectBlobGarbageAsync));
+
+  auto leveldbExportAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbExportAsync"),
+      5,  // dbs index, path, gte, lt, compress
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbExportAsync/" + dbErr);
+        }
+        std::string path;
+        std::shared_ptr<std::string> gte, lt;
+        if (!valueToString(runtime, arguments[1], &path) || !argumentToOptionalString(runtime, arguments, count, 2, &gte)
+            || !argumentToOptionalString(runtime, arguments, count, 3, &lt)) {
+          throw jsi::JSError(runtime, "leveldbExportAsync/invalid-params");
+        }
+        bool compress = count > 4 && arguments[4].isBool() && arguments[4].getBool();
+
+        return Async::promise(runtime, jsCallInvoker, [db, path, gte, lt, compress]() {
+          uint64_t entries = 0;
+          auto status = Dump::exportTo(*db, path, gte.get(), lt.get(), compress, &entries);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbExportAsync/" + status.ToString());
+          }
+          return [entries](jsi::Runtime& runtime) { return jsi::Value((double)entries); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbExportAsync", std::move(leveldbExportAsync));
+
+  auto leveldbCheckpointAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbCheckpointAsync"),
+      2,  // dbs index, dest db path
+      [documentDir, jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbCheckpointAsync/" + dbErr);
+        }
+        if (count < 2 || !arguments[1].isString()) {
+          throw jsi::JSError(runtime, "leveldbCheckpointAsync/invalid-params");
+        }
+        std::string dest = documentDir + arguments[1].getString(runtime).utf8(runtime);
+
+        return Async::promise(runtime, jsCallInvoker, [db, dest]() {
+          auto status = db->checkpoint(dest);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbCheckpointAsync/" + status.ToString());
+          }
+          return [](jsi::Runtime& runtime) { return jsi::Value(); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbCheckpointAsync", std::move(leveldbCheckpointAsync));
+
+  auto leveldbImportAsync = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbImportAsync"),
+      3,  // dbs index, path, chunkBytes
+      [jsCallInvoker](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string dbErr;
+        std::shared_ptr<DbHandle> db = valueToDb(arguments[0], &dbErr);
+        if (!db) {
+          throw jsi::JSError(runtime, "leveldbImportAsync/" + dbErr);
+        }
+        std::string path;
+        if (!valueToString(runtime, arguments[1], &path) || !arguments[2].isNumber() || arguments[2].getNumber() <= 0) {
+          throw jsi::JSError(runtime, "leveldbImportAsync/invalid-params");
+        }
+        size_t chunkBytes = (size_t)arguments[2].getNumber();
+
+        return Async::promise(runtime, jsCallInvoker, [db, path, chunkBytes]() {
+          uint64_t entries = 0;
+          auto status = Dump::importFrom(*db, path, chunkBytes, &entries);
+          if (!status.ok()) {
+            throw std::runtime_error("leveldbImportAsync/" + status.ToString());
+          }
+          return [entries](jsi::Runtime& runtime) { return jsi::Value((double)entries); };
+        });
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbImportAsync", std::move(leveldbImportAsync));
 
   auto leveldbReadFileBuf = jsi::Function::createFromHostFunction(
       jsiRuntime,
@@ -691,35 +2226,109 @@ void installLeveldb(jsi::Runtime& jsiRuntime, std::string documentDir) {
         if (!valueToString(runtime, arguments[0], &path) || !arguments[1].isNumber() || !arguments[2].isNumber()) {
           throw jsi::JSError(runtime, "leveldbReadFileBuf/invalid-params");
         }
-        int pos = (int)arguments[1].getNumber(), len = (int)arguments[2].getNumber();
-        std::ifstream file(path, std::ios::in | std::ios::binary);
-        if (!file || !file.is_open()) {
+        if (arguments[1].getNumber() < 0 || arguments[2].getNumber() < 0) {
+          throw jsi::JSError(runtime, "leveldbReadFileBuf/invalid-params");
+        }
+        uint64_t pos = (uint64_t)arguments[1].getNumber(), len = (uint64_t)arguments[2].getNumber();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
           throw jsi::JSError(runtime, "leveldbReadFileBuf/open-error/" + std::string(std::strerror(errno)));
         }
 
-        file.seekg(0, std::ios::end);
-        size_t file_size = file.tellg();
-        if (file_size < pos + len) {
-          throw jsi::JSError(runtime, "leveldbReadFileBuf/invalid-len-plus-pos");
+        std::string err;
+        struct stat st;
+        jsi::Object o = jsi::Object(runtime);
+        if (fstat(fd, &st) != 0) {
+          err = "open-error/" + std::string(std::strerror(errno));
+        } else if (pos > (uint64_t)st.st_size || len > (uint64_t)st.st_size - pos) {
+          err = "invalid-len-plus-pos";
+        } else {
+          jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
+          o = arrayBufferCtor.callAsConstructor(runtime, (double)len).getObject(runtime);
+          char* data = (char*)o.getArrayBuffer(runtime).data(runtime);
+          // pread() doesn't move a shared file position. Its offsets are 64-bit, 32-bit ABIs included, as the build
+          // defines _FILE_OFFSET_BITS=64.
+          for (uint64_t done = 0; done < len && err.empty();) {
+            ssize_t n = pread(fd, data + done, (size_t)(len - done), (off_t)(pos + done));
+            if (n > 0) {
+              done += (uint64_t)n;
+            } else if (n == 0) {
+              err = "read-error/unexpected-eof";
+            } else if (errno != EINTR) {
+              err = "read-error/" + std::string(std::strerror(errno));
+            }
+          }
         }
+        close(fd);
 
-        file.seekg(pos, std::ios::beg);
-
-        jsi::Function arrayBufferCtor = runtime.global().getPropertyAsFunction(runtime, "ArrayBuffer");
-        jsi::Object o = arrayBufferCtor.callAsConstructor(runtime, len).getObject(runtime);
-        jsi::ArrayBuffer buf = o.getArrayBuffer(runtime);
-        if (!file.read((char*)buf.data(runtime), len)) {
-          throw jsi::JSError(runtime, "leveldbReadFileBuf/read-error/" + std::string(std::strerror(errno)));
+        if (!err.empty()) {
+          throw jsi::JSError(runtime, "leveldbReadFileBuf/" + err);
         }
-
         return o;
       }
   );
     jsiRuntime.global().setProperty(jsiRuntime, "leveldbReadFileBuf", std::move(leveldbReadFileBuf));
+
+  auto leveldbOpenFileReader = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbOpenFileReader"),
+      1,  // path
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string path;
+        if (!valueToString(runtime, arguments[0], &path)) {
+          throw jsi::JSError(runtime, "leveldbOpenFileReader/invalid-params");
+        }
+        std::string err;
+        std::shared_ptr<MappedFile> file = MappedFile::open(path, &err);
+        if (!file) {
+          throw jsi::JSError(runtime, "leveldbOpenFileReader/" + err);
+        }
+        return jsi::Object::createFromHostObject(runtime, std::make_shared<FileReaderHostObject>(file));
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbOpenFileReader", std::move(leveldbOpenFileReader));
+
+  auto leveldbEncodeKey = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbEncodeKey"),
+      1,  // tuple
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        if (!arguments[0].isObject() || !arguments[0].getObject(runtime).isArray(runtime)) {
+          throw jsi::JSError(runtime, "leveldbEncodeKey/invalid-params");
+        }
+        std::string key = Tuple::encode(runtime, arguments[0].getObject(runtime).getArray(runtime));
+        return newArrayBuffer(runtime, key.data(), key.size());
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbEncodeKey", std::move(leveldbEncodeKey));
+
+  auto leveldbDecodeKey = jsi::Function::createFromHostFunction(
+      jsiRuntime,
+      jsi::PropNameID::forAscii(jsiRuntime, "leveldbDecodeKey"),
+      1,  // key
+      [](jsi::Runtime& runtime, const jsi::Value& thisValue, const jsi::Value* arguments, size_t count) -> jsi::Value {
+        std::string key;
+        if (!valueToString(runtime, arguments[0], &key)) {
+          throw jsi::JSError(runtime, "leveldbDecodeKey/invalid-params");
+        }
+        return Tuple::decode(runtime, key.data(), key.size());
+      }
+  );
+  jsiRuntime.global().setProperty(jsiRuntime, "leveldbDecodeKey", std::move(leveldbDecodeKey));
 }
 
-void cleanupLeveldb() {
+void cleanupLeveldb(jsi::Runtime& jsiRuntime) {
+  // Its watches would call back into it.
+  unwatchAll(jsiRuntime, -1);
+  // Other runtimes may still be using the DBs, in which case the last one to clean up closes them.
+  if (--installedRuntimes > 0) {
+    return;
+  }
   iterators.clear();
+  {
+    std::lock_guard<std::mutex> lock(openPathsMutex);
+    openPaths.clear();
+  }
   dbs.clear();
 }
 
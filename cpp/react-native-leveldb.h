@@ -1,4 +1,12 @@
 #include <jsi/jsi.h>
+#include <ReactCommon/CallInvoker.h>
 
-void installLeveldb(facebook::jsi::Runtime& jsiRuntime, std::string _documentDir);
-void cleanupLeveldb();
\ No newline at end of file
+// Installs the leveldb* functions on the global object of `jsiRuntime`. This may be called for several runtimes
+// (e.g. a worklet runtime next to the main one): they share open DBs, and DB handles can be passed between them.
+// Each call must be paired with a call to cleanupLeveldb() for the same runtime; the last one closes all DBs and
+// iterators. `jsCallInvoker` schedules work on the runtime's JS thread, it's how asynchronous functions settle their
+// promises.
+void installLeveldb(facebook::jsi::Runtime& jsiRuntime, std::string _documentDir,
+                    std::shared_ptr<facebook::react::CallInvoker> jsCallInvoker);
+// Drops the watches of `jsiRuntime`, which is only used to identify them.
+void cleanupLeveldb(facebook::jsi::Runtime& jsiRuntime);
@@ -0,0 +1,121 @@
+#include "ttl.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace Ttl {
+
+namespace {
+
+const char kHeader[2] = {(char)0xc1, 0x01};
+const size_t kHeaderSize = sizeof(kHeader) + 8;
+
+// Returns false if `value` has no header.
+bool expiry(const leveldb::Slice& value, int64_t* expiresAt) {
+  if (value.size() < kHeaderSize || value[0] != kHeader[0] || value[1] != kHeader[1]) {
+    return false;
+  }
+  uint64_t bits = 0;
+  for (size_t i = sizeof(kHeader); i < kHeaderSize; i++) {
+    bits = (bits << 8) | (uint8_t)value[i];
+  }
+  *expiresAt = (int64_t)bits;
+  return true;
+}
+
+bool expired(const leveldb::Slice& value, int64_t now) {
+  int64_t expiresAt;
+  return expiry(value, &expiresAt) && expiresAt <= now;
+}
+
+}  // namespace
+
+int64_t now() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string header(int64_t expiresAt) {
+  std::string header(kHeader, sizeof(kHeader));
+  for (int i = 7; i >= 0; i--) {
+    header.push_back((char)((uint64_t)expiresAt >> (8 * i)));
+  }
+  return header;
+}
+
+bool live(leveldb::Slice* value, int64_t now) {
+  int64_t expiresAt;
+  if (!expiry(*value, &expiresAt)) {
+    return true;
+  }
+  if (expiresAt <= now) {
+    return false;
+  }
+  value->remove_prefix(kHeaderSize);
+  return true;
+}
+
+leveldb::Status sweep(DbHandle& db, size_t chunkBytes, uint64_t* deleted) {
+  *deleted = 0;
+  leveldb::ReadOptions readOptions;
+  // A one-off scan: don't evict the blocks that the app is actually using from the cache.
+  readOptions.fill_cache = false;
+  std::unique_ptr<leveldb::Iterator> it(db.newIterator(readOptions));
+
+  std::vector<std::string> keys;
+  size_t keysBytes = 0;
+  // The keys were found expired by the scan, but may have been rewritten since: check them again, with writes held
+  // off until the deletes are committed.
+  auto commit = [&]() {
+    if (keys.empty()) {
+      return leveldb::Status::OK();
+    }
+    int64_t commitNow = now();
+    uint64_t deletes = 0;
+    leveldb::Status status = db.update(db.writeOptions(), [&](leveldb::WriteBatch* batch) {
+      std::string value;
+      for (const std::string& key : keys) {
+        leveldb::Status status = db.get(leveldb::ReadOptions(), key, &value);
+        if (status.IsNotFound()) {
+          continue;
+        }
+        if (!status.ok()) {
+          return status;
+        }
+        if (expired(value, commitNow)) {
+          batch->Delete(key);
+          deletes++;
+        }
+      }
+      return leveldb::Status::OK();
+    });
+    if (status.ok()) {
+      *deleted += deletes;
+    }
+    keys.clear();
+    keysBytes = 0;
+    return status;
+  };
+
+  int64_t scanNow = now();
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    if (!expired(it->value(), scanNow)) {
+      continue;
+    }
+    keys.push_back(it->key().ToString());
+    keysBytes += it->key().size();
+    if (keysBytes >= chunkBytes) {
+      leveldb::Status status = commit();
+      if (!status.ok()) {
+        return status;
+      }
+    }
+  }
+  if (!it->status().ok()) {
+    return it->status();
+  }
+  return commit();
+}
+
+}  // namespace Ttl
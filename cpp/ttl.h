@@ -0,0 +1,30 @@
+#ifndef ttl_h
+#define ttl_h
+
+#include <cstdint>
+#include <string>
+#include <leveldb/slice.h>
+#include <leveldb/status.h>
+#include "db-handle.h"
+
+// Values that expire. An expiring value is stored with a header: 0xc1 0x01 then its expiry, as a big-endian fixed64
+// count of milliseconds since the epoch, then the msgpack value. 0xc1 is never used by msgpack, so the header can't be
+// mistaken for the start of a value.
+//
+// Expired values are treated as missing by the reads that decode values, and deleted by sweep().
+namespace Ttl {
+  // Milliseconds since the epoch.
+  int64_t now();
+
+  // The header of a value that expires at `expiresAt`.
+  std::string header(int64_t expiresAt);
+
+  // Returns false if `*value` has expired by `now`. Otherwise strips its header, if any, from `*value`.
+  bool live(leveldb::Slice* value, int64_t now);
+
+  // Deletes the values that have expired, committing the deletes in batches of about `chunkBytes`. Values rewritten
+  // since they were found expired are left alone.
+  leveldb::Status sweep(DbHandle& db, size_t chunkBytes, uint64_t* deleted);
+}
+
+#endif /* ttl_h */
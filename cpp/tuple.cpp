@@ -0,0 +1,235 @@
+#include "tuple.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "file-reader.h"
+
+namespace Tuple {
+
+namespace {
+
+const uint8_t kNull = 0x00;
+const uint8_t kBytes = 0x01;
+const uint8_t kString = 0x02;
+const uint8_t kNested = 0x05;
+const uint8_t kIntZero = 0x14;
+const uint8_t kDouble = 0x21;
+const uint8_t kFalse = 0x26;
+const uint8_t kTrue = 0x27;
+// Nulls in nested tuples are escaped, to tell them from the end of the tuple.
+const uint8_t kEscape = 0xff;
+
+const uint64_t kSignBit = 1ULL << 63;
+const double kMaxSafeInteger = 9007199254740991.0;
+// How deep tuples can nest, the same limit as unpackElement()'s.
+const int kMaxDepth = 32;
+
+// Writes `bytes` with each 0x00 escaped as 0x00 0xff, then a terminating 0x00.
+void encodeBytes(const char* bytes, size_t size, std::string* out) {
+  for (size_t i = 0; i < size; i++) {
+    out->push_back(bytes[i]);
+    if (bytes[i] == 0) {
+      out->push_back((char)kEscape);
+    }
+  }
+  out->push_back((char)kNull);
+}
+
+void encodeBigEndian(uint64_t value, int bytes, std::string* out) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    out->push_back((char)(value >> (8 * i)));
+  }
+}
+
+// All ones in the low `bytes` bytes.
+uint64_t mask(int bytes) {
+  return bytes == 8 ? ~0ULL : (1ULL << (8 * bytes)) - 1;
+}
+
+void encodeNumber(double number, std::string* out) {
+  if (std::trunc(number) == number && std::fabs(number) <= kMaxSafeInteger) {
+    if (number == 0) {
+      out->push_back((char)kIntZero);
+      return;
+    }
+    uint64_t magnitude = (uint64_t)std::fabs(number);
+    int bytes = 0;
+    while (bytes < 8 && (magnitude >> (8 * bytes)) != 0) {
+      bytes++;
+    }
+    // Negative integers are stored as ones' complement, so that larger magnitudes sort first.
+    if (number > 0) {
+      out->push_back((char)(kIntZero + bytes));
+      encodeBigEndian(magnitude, bytes, out);
+    } else {
+      out->push_back((char)(kIntZero - bytes));
+      encodeBigEndian(~magnitude & mask(bytes), bytes, out);
+    }
+    return;
+  }
+
+  // Flipping the sign bit of positive doubles, and all bits of negative ones, makes them sort bytewise.
+  uint64_t bits;
+  memcpy(&bits, &number, sizeof(bits));
+  bits = (bits & kSignBit) ? ~bits : bits ^ kSignBit;
+  out->push_back((char)kDouble);
+  encodeBigEndian(bits, 8, out);
+}
+
+void encodeElement(jsi::Runtime& runtime, const jsi::Value& value, int depth, std::string* out) {
+  bool nested = depth > 0;
+  if (depth >= kMaxDepth) {
+    throw jsi::JSError(runtime, "tuple/ maximum depth reached");
+  } else if (value.isNull()) {
+    out->push_back((char)kNull);
+    if (nested) {
+      out->push_back((char)kEscape);
+    }
+  } else if (value.isBool()) {
+    out->push_back((char)(value.getBool() ? kTrue : kFalse));
+  } else if (value.isNumber()) {
+    encodeNumber(value.getNumber(), out);
+  } else if (value.isString()) {
+    std::string str = value.getString(runtime).utf8(runtime);
+    out->push_back((char)kString);
+    encodeBytes(str.data(), str.size(), out);
+  } else if (value.isObject()) {
+    jsi::Object obj = value.getObject(runtime);
+    if (obj.isArrayBuffer(runtime)) {
+      jsi::ArrayBuffer buf = obj.getArrayBuffer(runtime);
+      out->push_back((char)kBytes);
+      encodeBytes((const char*)buf.data(runtime), buf.size(runtime), out);
+    } else if (obj.isArray(runtime)) {
+      jsi::Array array = obj.getArray(runtime);
+      size_t length = array.size(runtime);
+      out->push_back((char)kNested);
+      for (size_t i = 0; i < length; i++) {
+        encodeElement(runtime, array.getValueAtIndex(runtime, i), depth + 1, out);
+      }
+      out->push_back((char)kNull);
+    } else {
+      throw jsi::JSError(runtime, "tuple/ only arrays and ArrayBuffers are supported as objects");
+    }
+  } else {
+    throw jsi::JSError(runtime, "tuple/ unsupported element type");
+  }
+}
+
+class Decoder {
+ public:
+  Decoder(jsi::Runtime& runtime, const char* data, size_t size)
+      : runtime_(runtime), data_((const uint8_t*)data), size_(size) {}
+
+  jsi::Array decodeAll() {
+    std::vector<jsi::Value> elements;
+    while (pos_ < size_) {
+      elements.push_back(decodeElement(0));
+    }
+    return toArray(elements);
+  }
+
+ private:
+  jsi::Value decodeElement(int depth) {
+    if (depth >= kMaxDepth) {
+      throw jsi::JSError(runtime_, "tuple/ maximum depth reached");
+    }
+    bool nested = depth > 0;
+    uint8_t code = data_[pos_++];
+    if (code == kNull) {
+      // In nested tuples, only escaped nulls get here.
+      pos_ += nested ? 1 : 0;
+      return jsi::Value::null();
+    } else if (code == kBytes) {
+      std::string bytes = decodeBytes();
+      return newArrayBuffer(runtime_, bytes.data(), bytes.size());
+    } else if (code == kString) {
+      return jsi::String::createFromUtf8(runtime_, decodeBytes());
+    } else if (code == kNested) {
+      std::vector<jsi::Value> elements;
+      while (true) {
+        need(1);
+        if (data_[pos_] == kNull && !(pos_ + 1 < size_ && data_[pos_ + 1] == kEscape)) {
+          pos_++;
+          break;
+        }
+        elements.push_back(decodeElement(depth + 1));
+      }
+      return toArray(elements);
+    } else if (code >= kIntZero - 8 && code <= kIntZero + 8) {
+      int bytes = code > kIntZero ? code - kIntZero : kIntZero - code;
+      uint64_t value = decodeBigEndian(bytes);
+      return code >= kIntZero ? jsi::Value((double)value) : jsi::Value(-(double)(~value & mask(bytes)));
+    } else if (code == kDouble) {
+      uint64_t bits = decodeBigEndian(8);
+      bits = (bits & kSignBit) ? bits ^ kSignBit : ~bits;
+      double number;
+      memcpy(&number, &bits, sizeof(number));
+      return jsi::Value(number);
+    } else if (code == kFalse || code == kTrue) {
+      return jsi::Value(code == kTrue);
+    }
+    throw jsi::JSError(runtime_, "tuple/ unsupported type code " + std::to_string(code));
+  }
+
+  std::string decodeBytes() {
+    std::string bytes;
+    while (true) {
+      need(1);
+      uint8_t byte = data_[pos_++];
+      if (byte == kNull) {
+        if (pos_ < size_ && data_[pos_] == kEscape) {
+          pos_++;
+        } else {
+          return bytes;
+        }
+      }
+      bytes.push_back((char)byte);
+    }
+  }
+
+  uint64_t decodeBigEndian(int bytes) {
+    need(bytes);
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+      value = (value << 8) | data_[pos_++];
+    }
+    return value;
+  }
+
+  void need(size_t bytes) {
+    if (size_ - pos_ < bytes) {
+      throw jsi::JSError(runtime_, "tuple/ truncated");
+    }
+  }
+
+  jsi::Array toArray(std::vector<jsi::Value>& elements) {
+    jsi::Array array(runtime_, elements.size());
+    for (size_t i = 0; i < elements.size(); i++) {
+      array.setValueAtIndex(runtime_, i, std::move(elements[i]));
+    }
+    return array;
+  }
+
+  jsi::Runtime& runtime_;
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+std::string encode(jsi::Runtime& runtime, const jsi::Array& tuple) {
+  std::string out;
+  size_t length = tuple.size(runtime);
+  for (size_t i = 0; i < length; i++) {
+    encodeElement(runtime, tuple.getValueAtIndex(runtime, i), 0, &out);
+  }
+  return out;
+}
+
+jsi::Array decode(jsi::Runtime& runtime, const char* data, size_t size) {
+  return Decoder(runtime, data, size).decodeAll();
+}
+
+}  // namespace Tuple
@@ -0,0 +1,24 @@
+#ifndef tuple_h
+#define tuple_h
+
+#include <string>
+#include <jsi/jsi.h>
+
+using namespace facebook;
+
+// Encodes arrays of strings, numbers, booleans, nulls, ArrayBuffers and nested arrays into keys that sort bytewise in
+// the same order as the arrays do element by element, following FoundationDB's tuple layer. Encoded keys are shorter
+// than zero-padded strings, and an encoded prefix of a tuple is a byte prefix of its encoding, so prefix scans need no
+// separators.
+//
+// Elements of different types sort by type: null, ArrayBuffers, strings, nested arrays, integers, non-integer numbers,
+// then booleans. Numbers that are safe integers are encoded as integers, which take 1 to 8 bytes depending on their
+// magnitude; other numbers as doubles.
+namespace Tuple {
+  // Throws a JSError if an element can't be encoded.
+  std::string encode(jsi::Runtime& runtime, const jsi::Array& tuple);
+  // Throws a JSError if `data` isn't an encoded tuple.
+  jsi::Array decode(jsi::Runtime& runtime, const char* data, size_t size);
+}
+
+#endif /* tuple_h */
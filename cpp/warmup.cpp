@@ -0,0 +1,183 @@
+#include "warmup.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <leveldb/iterator.h>
+#include <leveldb/options.h>
+#include "db-handle.h"
+
+namespace Warmup {
+
+namespace {
+
+const uint8_t kVersion = 1;
+const uint8_t kFlagPoint = 1;
+const uint8_t kFlagGte = 2;
+const uint8_t kFlagLt = 4;
+const size_t kMaxEntries = 1000;
+
+void putVarint32(std::string* dst, uint32_t value) {
+  while (value >= 0x80) {
+    dst->push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  dst->push_back((char)value);
+}
+
+// Returns false if `*pos` doesn't point to a complete varint within `data`.
+bool getVarint32(const std::string& data, size_t* pos, uint32_t* value) {
+  *value = 0;
+  for (int shift = 0; shift <= 28 && *pos < data.size(); shift += 7) {
+    uint32_t byte = (uint8_t)data[(*pos)++];
+    *value |= (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void putSlice(std::string* dst, const leveldb::Slice& slice) {
+  putVarint32(dst, (uint32_t)slice.size());
+  dst->append(slice.data(), slice.size());
+}
+
+bool getString(const std::string& data, size_t* pos, std::shared_ptr<std::string>* value) {
+  uint32_t size;
+  if (!getVarint32(data, pos, &size) || data.size() - *pos < size) {
+    return false;
+  }
+  *value = std::make_shared<std::string>(data, *pos, size);
+  *pos += size;
+  return true;
+}
+
+leveldb::Status save(const std::string& path, const std::string& entries) {
+  std::string tmpPath = path + ".tmp";
+  FILE* file = fopen(tmpPath.c_str(), "wb");
+  if (!file) {
+    return leveldb::Status::IOError(tmpPath, strerror(errno));
+  }
+  std::string data(1, (char)kVersion);
+  data.append(entries);
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+  if (fclose(file) != 0 || !written || rename(tmpPath.c_str(), path.c_str()) != 0) {
+    leveldb::Status status = leveldb::Status::IOError(path, strerror(errno));
+    remove(tmpPath.c_str());
+    return status;
+  }
+  return leveldb::Status::OK();
+}
+
+}  // namespace
+
+std::string sidecarPath(const std::string& dbPath) {
+  return dbPath + ".warmup";
+}
+
+leveldb::Status load(const std::string& path, std::vector<Range>* ranges) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return errno == ENOENT ? leveldb::Status::OK() : leveldb::Status::IOError(path, strerror(errno));
+  }
+  std::string data;
+  char buf[4096];
+  size_t read;
+  while ((read = fread(buf, 1, sizeof(buf), file)) > 0) {
+    data.append(buf, read);
+  }
+  fclose(file);
+
+  if (data.empty() || (uint8_t)data[0] != kVersion) {
+    return leveldb::Status::NotSupported(path, "unknown warmup version");
+  }
+  for (size_t pos = 1; pos < data.size();) {
+    uint8_t flags = (uint8_t)data[pos++];
+    Range range;
+    range.point = flags & kFlagPoint;
+    if (((flags & kFlagGte) && !getString(data, &pos, &range.gte)) ||
+        ((flags & kFlagLt) && !getString(data, &pos, &range.lt)) || (range.point && !range.gte)) {
+      return leveldb::Status::Corruption(path, "truncated warmup entry");
+    }
+    ranges->push_back(std::move(range));
+  }
+  return leveldb::Status::OK();
+}
+
+void prefetch(const std::weak_ptr<DbHandle>& db, const std::vector<Range>& ranges, size_t maxBytes) {
+  leveldb::ReadOptions options;
+  options.fill_cache = true;
+  size_t bytes = 0;
+  for (const Range& range : ranges) {
+    // Not holding on to the DB between ranges, so that closing it isn't held up for long.
+    std::shared_ptr<DbHandle> handle = db.lock();
+    if (!handle || bytes >= maxBytes) {
+      return;
+    }
+    // Through an iterator rather than get(), which would record the read. Positioning the iterator is what loads the
+    // blocks.
+    std::unique_ptr<leveldb::Iterator> it(handle->newIterator(options));
+    for (range.gte ? it->Seek(*range.gte) : it->SeekToFirst(); it->Valid() && bytes < maxBytes; it->Next()) {
+      if (range.lt && handle->comparator()->Compare(it->key(), *range.lt) >= 0) {
+        break;
+      }
+      bytes += it->key().size() + it->value().size();
+      if (range.point) {
+        break;
+      }
+    }
+  }
+}
+
+Recorder::~Recorder() {
+  stop();
+}
+
+void Recorder::start(const std::string& sidecar, std::chrono::milliseconds duration) {
+  recording_ = true;
+  auto deadline = std::chrono::steady_clock::now() + duration;
+  saver_ = std::thread([this, sidecar, deadline]() {
+    std::string entries;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait_until(lock, deadline, [this]() { return stopped_; });
+      recording_ = false;
+      entries.swap(entries_);
+      seen_.clear();
+    }
+    // Best effort: the next open just has less to prefetch. Keeps the previous recording if there's nothing new, e.g.
+    // if the DB was closed right away.
+    if (!entries.empty()) {
+      save(sidecar, entries);
+    }
+  });
+}
+
+void Recorder::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+  if (saver_.joinable()) {
+    saver_.join();
+  }
+}
+
+void Recorder::record(bool point, const leveldb::Slice* gte, const leveldb::Slice* lt) {
+  std::string entry(1, (char)((point ? kFlagPoint : 0) | (gte ? kFlagGte : 0) | (lt ? kFlagLt : 0)));
+  if (gte) {
+    putSlice(&entry, *gte);
+  }
+  if (lt) {
+    putSlice(&entry, *lt);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!recording_.load() || seen_.size() >= kMaxEntries || !seen_.insert(entry).second) {
+    return;
+  }
+  entries_.append(entry);
+}
+
+}  // namespace Warmup
@@ -0,0 +1,82 @@
+#ifndef warmup_h
+#define warmup_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <leveldb/slice.h>
+#include <leveldb/status.h>
+
+class DbHandle;
+
+// Warming up the block cache after a DB opens, so that the first reads of a launch don't each wait on the disk.
+//
+// What to read comes from the `prefetch` open option, and from the reads recorded during the first moments after the
+// previous open, which are saved to a sidecar file next to the DB (see sidecarPath()). The sidecar holds a version
+// byte, then one entry per read: a flags byte, then the varint32-prefixed bounds that the flags say are there.
+namespace Warmup {
+  // A key read with get() (`point`), or the keys in [gte, lt), either bound may be null.
+  struct Range {
+    bool point = false;
+    std::shared_ptr<std::string> gte, lt;
+  };
+
+  std::string sidecarPath(const std::string& dbPath);
+  // Reads the ranges recorded in a sidecar. A missing sidecar has none.
+  leveldb::Status load(const std::string& path, std::vector<Range>* ranges);
+
+  // Reads `ranges` in order, filling the block cache, until about `maxBytes` of keys and values were read: past the
+  // size of the cache, prefetching would only evict what it read first. Stops early once `db` is destroyed.
+  void prefetch(const std::weak_ptr<DbHandle>& db, const std::vector<Range>& ranges, size_t maxBytes);
+
+  // Records the reads made through a DB for a while after it opens, up to a thousand of them, then saves them to its
+  // sidecar from a thread of its own. The sidecar is written next to its path and renamed into place once complete.
+  // Recording is a single atomic load once it's over.
+  class Recorder {
+   public:
+    ~Recorder();
+
+    // Records for `duration`. Called at most once.
+    void start(const std::string& sidecar, std::chrono::milliseconds duration);
+    // Saves what was recorded so far, if it's still recording.
+    void stop();
+
+    void recordKey(const leveldb::Slice& key) {
+      if (recording_.load()) {
+        record(true, &key, nullptr);
+      }
+    }
+    void recordRange(const std::string* gte, const std::string* lt) {
+      if (recording_.load()) {
+        leveldb::Slice gteSlice, ltSlice;
+        if (gte) {
+          gteSlice = *gte;
+        }
+        if (lt) {
+          ltSlice = *lt;
+        }
+        record(false, gte ? &gteSlice : nullptr, lt ? &ltSlice : nullptr);
+      }
+    }
+
+   private:
+    void record(bool point, const leveldb::Slice* gte, const leveldb::Slice* lt);
+
+    std::atomic<bool> recording_{false};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread saver_;
+    bool stopped_ = false;
+    // The sidecar entries recorded so far, without duplicates.
+    std::string entries_;
+    std::unordered_set<std::string> seen_;
+  };
+}
+
+#endif /* warmup_h */
@@ -0,0 +1,136 @@
+#include "watch.h"
+
+#include <algorithm>
+
+class Watchers::BatchPublisher : public leveldb::WriteBatch::Handler {
+ public:
+  BatchPublisher(Watchers* watchers, std::vector<std::shared_ptr<Subscription>>* first)
+      : watchers_(watchers), first_(first) {}
+
+  void Put(const leveldb::Slice& key, const leveldb::Slice& value) override {
+    watchers_->publishLocked(key, first_);
+  }
+
+  void Delete(const leveldb::Slice& key) override {
+    watchers_->publishLocked(key, first_);
+  }
+
+ private:
+  Watchers* watchers_;
+  std::vector<std::shared_ptr<Subscription>>* first_;
+};
+
+int Watchers::add(const std::string* gte, const std::string* lt, OnFirstChange onFirstChange) {
+  auto subscription = std::make_shared<Subscription>();
+  subscription->hasGte = gte != nullptr;
+  subscription->gte = gte ? *gte : std::string();
+  subscription->hasLt = lt != nullptr;
+  subscription->lt = lt ? *lt : std::string();
+  subscription->onFirstChange = std::move(onFirstChange);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  subscription->id = nextId_++;
+  byId_[subscription->id] = subscription;
+  if (gte) {
+    byLowerBound_.emplace(*gte, subscription);
+  } else {
+    unbounded_.push_back(subscription);
+  }
+  count_++;
+  return subscription->id;
+}
+
+bool Watchers::remove(int id) {
+  std::shared_ptr<Subscription> subscription;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = byId_.find(id);
+    if (it == byId_.end()) {
+      return false;
+    }
+    subscription = std::move(it->second);
+    byId_.erase(it);
+    if (subscription->hasGte) {
+      auto range = byLowerBound_.equal_range(subscription->gte);
+      for (auto entry = range.first; entry != range.second; ++entry) {
+        if (entry->second == subscription) {
+          byLowerBound_.erase(entry);
+          break;
+        }
+      }
+    } else {
+      unbounded_.erase(std::find(unbounded_.begin(), unbounded_.end(), subscription));
+    }
+    count_--;
+  }
+  // Its callback is destroyed outside of the lock, in case that runs code that publishes.
+  return true;
+}
+
+std::vector<std::string> Watchers::take(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = byId_.find(id);
+  if (it == byId_.end()) {
+    return {};
+  }
+  std::vector<std::string> changed;
+  changed.swap(it->second->changed);
+  it->second->changedSet.clear();
+  return changed;
+}
+
+void Watchers::publish(const leveldb::Slice& key) {
+  if (count_.load() == 0) {
+    return;
+  }
+  std::vector<std::shared_ptr<Subscription>> first;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    publishLocked(key, &first);
+  }
+  notify(first);
+}
+
+void Watchers::publish(const leveldb::WriteBatch& batch) {
+  if (count_.load() == 0) {
+    return;
+  }
+  std::vector<std::shared_ptr<Subscription>> first;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    BatchPublisher publisher(this, &first);
+    batch.Iterate(&publisher);
+  }
+  notify(first);
+}
+
+void Watchers::publishLocked(const leveldb::Slice& key, std::vector<std::shared_ptr<Subscription>>* first) {
+  for (const auto& subscription : unbounded_) {
+    recordLocked(subscription, key, first);
+  }
+  auto end = byLowerBound_.upper_bound(key.ToString());
+  for (auto it = byLowerBound_.begin(); it != end; ++it) {
+    recordLocked(it->second, key, first);
+  }
+}
+
+void Watchers::recordLocked(const std::shared_ptr<Subscription>& subscription, const leveldb::Slice& key,
+                            std::vector<std::shared_ptr<Subscription>>* first) {
+  if (subscription->hasLt && comparator_->Compare(key, subscription->lt) >= 0) {
+    return;
+  }
+  std::string changed = key.ToString();
+  if (!subscription->changedSet.insert(changed).second) {
+    return;
+  }
+  if (subscription->changed.empty()) {
+    first->push_back(subscription);
+  }
+  subscription->changed.push_back(std::move(changed));
+}
+
+void Watchers::notify(const std::vector<std::shared_ptr<Subscription>>& first) {
+  for (const auto& subscription : first) {
+    subscription->onFirstChange(subscription->id);
+  }
+}
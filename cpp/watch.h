@@ -0,0 +1,75 @@
+#ifndef watch_h
+#define watch_h
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <leveldb/comparator.h>
+#include <leveldb/slice.h>
+#include <leveldb/write_batch.h>
+
+// Subscriptions to the changes of key ranges of a DB. Writes publish the keys that they change, and each subscription
+// collects those in its range until they are taken. A subscription is told when the first key arrives, so that it can
+// schedule their delivery: changes are coalesced until then.
+//
+// Subscriptions are indexed by their lower bound, so a write only looks at the subscriptions that start at or before
+// each key it changes. Publishing is a single atomic load when there are no subscriptions.
+class Watchers {
+ public:
+  // Called with the id of a subscription when it gets its first change since the last take().
+  using OnFirstChange = std::function<void(int id)>;
+
+  explicit Watchers(const leveldb::Comparator* comparator) : byLowerBound_(Less{comparator}), comparator_(comparator) {}
+
+  // Subscribes to the changes of the keys in [gte, lt), either bound may be null. Returns the subscription's id.
+  int add(const std::string* gte, const std::string* lt, OnFirstChange onFirstChange);
+  // Returns false if `id` isn't subscribed.
+  bool remove(int id);
+  // Returns the keys changed since the last call, in the order they first changed.
+  std::vector<std::string> take(int id);
+
+  void publish(const leveldb::Slice& key);
+  void publish(const leveldb::WriteBatch& batch);
+
+ private:
+  struct Subscription {
+    int id;
+    bool hasGte;
+    std::string gte;
+    bool hasLt;
+    std::string lt;
+    OnFirstChange onFirstChange;
+    std::vector<std::string> changed;
+    std::unordered_set<std::string> changedSet;
+  };
+  struct Less {
+    const leveldb::Comparator* comparator;
+    bool operator()(const std::string& a, const std::string& b) const {
+      return comparator->Compare(a, b) < 0;
+    }
+  };
+  class BatchPublisher;
+
+  // Records `key` in the subscriptions whose range holds it. Appends the ones that got their first change to `first`.
+  void publishLocked(const leveldb::Slice& key, std::vector<std::shared_ptr<Subscription>>* first);
+  void recordLocked(const std::shared_ptr<Subscription>& subscription, const leveldb::Slice& key,
+                    std::vector<std::shared_ptr<Subscription>>* first);
+  static void notify(const std::vector<std::shared_ptr<Subscription>>& first);
+
+  std::mutex mutex_;
+  std::atomic<int> count_{0};
+  int nextId_ = 0;
+  std::unordered_map<int, std::shared_ptr<Subscription>> byId_;
+  std::multimap<std::string, std::shared_ptr<Subscription>, Less> byLowerBound_;
+  // The subscriptions with no lower bound.
+  std::vector<std::shared_ptr<Subscription>> unbounded_;
+  const leveldb::Comparator* comparator_;
+};
+
+#endif /* watch_h */
@@ -25,21 +25,21 @@ export function benchmarkLeveldb(): BenchmarkResults {
   const writeKeys = Object.keys(writeKvs);
 
   // === writeMany
-  let started = new Date().getTime();
-  db.batchStr(writeKvs, []);
+  let started = performance.now();
+  db.batchObjects(writeKvs, []);
 
   res.writeMany = {
-    durationMs: new Date().getTime() - started,
+    durationMs: performance.now() - started,
     numKeys: writeKeys.length,
   };
 
   // === readMany
   let readKvs: Record<string, string> = {};
-  started = new Date().getTime();
-  readKvs = db.getAllStr();
+  started = performance.now();
+  readKvs = db.getAllObjects();
   res.readMany = {
     numKeys: Object.keys(readKvs).length,
-    durationMs: new Date().getTime() - started,
+    durationMs: performance.now() - started,
   };
   db.close();
 
@@ -66,22 +66,22 @@ export function benchmarkJSONvsMPack(): BenchmarkResults {
   const writeKeys = Object.keys(writeKvs);
 
   // === writeMany
-  let started = new Date().getTime();
+  let started = performance.now();
   dbMpack.batchObjects(writeKvs, []);
 
   const writeManyMpack = {
-    durationMs: new Date().getTime() - started,
+    durationMs: performance.now() - started,
     numKeys: writeKeys.length,
   };
 
   // === readMany
   let readKvs: Record<string, string> = {};
-  started = new Date().getTime();
+  started = performance.now();
   readKvs = dbMpack.getAllObjects();
 
   const readManyMpack = {
     numKeys: Object.keys(readKvs).length,
-    durationMs: new Date().getTime() - started,
+    durationMs: performance.now() - started,
   };
   dbMpack.close();
 
@@ -1,11 +1,15 @@
 #import "Leveldb.h"
 #import <React/RCTBridge+Private.h>
 #import <React/RCTUtils.h>
+#import <ReactCommon/CallInvoker.h>
 #import "react-native-leveldb.h"
 
 using namespace facebook;
 
-@implementation Leveldb
+@implementation Leveldb {
+  // The runtime that the bindings were installed on, if any.
+  jsi::Runtime *_runtime;
+}
 @synthesize bridge = _bridge;
 @synthesize methodQueue = _methodQueue;
 
@@ -23,12 +27,16 @@ RCT_EXPORT_BLOCKING_SYNCHRONOUS_METHOD(install)
     return @false;
   }
   NSURL *docPath = [[NSFileManager defaultManager] URLsForDirectory:NSDocumentDirectory inDomains:NSUserDomainMask][0];
-  installLeveldb(*(jsi::Runtime *)cxxBridge.runtime, std::string([[docPath path] UTF8String]));
+  _runtime = (jsi::Runtime *)cxxBridge.runtime;
+  installLeveldb(*_runtime, std::string([[docPath path] UTF8String]), cxxBridge.jsCallInvoker);
   return @true;
 }
 
 - (void)invalidate {
-  cleanupLeveldb();
+  if (_runtime != nullptr) {
+    cleanupLeveldb(*_runtime);
+    _runtime = nullptr;
+  }
 }
 
 
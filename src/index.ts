@@ -64,6 +64,109 @@ export interface LevelDBIteratorI {
   valueBuf(): ArrayBuffer;
 }
 
+// 'bulkLoad' tunes the DB for loading lots of data (e.g. on initial sync): a 64MB memtable and large tables mean far
+// fewer level-0 flushes and compactions, so that writes rarely stall on them. 'interactive' is the default tuning.
+export type LevelDBProfile = 'interactive' | 'bulkLoad';
+
+// The tuning options only apply when the DB is actually opened: opening a DB that is already open (e.g. by another
+// runtime) shares it as it is.
+export interface LevelDBOpenOptions {
+  // The durability of writes that don't specify one, see LevelDBWriteOptions.sync. Defaults to false.
+  sync?: boolean;
+  // Bits per key of the Bloom filters, which let point lookups skip the tables that don't have a key. More bits mean
+  // fewer wasted disk reads for missing keys, at the cost of memory (10 bits: ~1% false positives, 14 bits: ~0.2%).
+  // 0 disables the filters, which only pays off for DBs that are scanned rather than looked up. Defaults to 10.
+  bloomBitsPerKey?: number;
+  // Share one filter policy between all DBs opened with the same bloomBitsPerKey. Defaults to false.
+  sharedFilterPolicy?: boolean;
+  // Approximate size of the data in a table block, in bytes. Larger blocks favor scans, smaller ones point lookups.
+  // Defaults to 4KB.
+  blockSize?: number;
+  // Bytes of writes to buffer in memory before they're written out as a sorted table. Larger buffers speed up bulk
+  // writes, at the cost of memory and of a longer recovery on open. Defaults to 4MB.
+  writeBufferSize?: number;
+  // The number of table files that LevelDB keeps open. Defaults to 1000.
+  maxOpenFiles?: number;
+  // See LevelDBProfile and LevelDB.setProfile(). Defaults to 'interactive'.
+  profile?: LevelDBProfile;
+  // The order of the keys, which is what iterators follow. A DB must always be opened with the same comparator.
+  // - 'bytewise': lexicographic order of the raw bytes. The default.
+  // - 'reverse': bytewise, reversed, e.g. so that newest-first scans over timestamped keys go forwards.
+  // - 'int64': keys start with a 64-bit big-endian signed integer (see DataView.setBigInt64()), and sort by its value,
+  //   then by the rest of the key. This keeps numeric keys compact, with no zero-padding. Keys shorter than 8 bytes
+  //   sort first.
+  comparator?: 'bytewise' | 'reverse' | 'int64';
+  // Key ranges to read in the background as soon as the DB opens, e.g. what the first screen shows, so that they're
+  // in the block cache by the time the app reads them. Either bound may be omitted.
+  prefetch?: { gte?: LevelDBKey; lt?: LevelDBKey }[];
+  // Records what's read in the first `recordWarmupMs` after the DB opens (keys read with get(), ranges read with
+  // getAllObjects(), getAllObjectsAsync() and scanPrefix()) to a file next to the DB, and prefetches it, after the
+  // `prefetch` ranges, the next time the DB is opened with this option. Only applies when this call actually opens
+  // the DB, rather than sharing one that's already open.
+  recordWarmupMs?: number;
+  // Stops prefetching once this many bytes were read. Defaults to 8MB, the size of LevelDB's block cache: prefetching
+  // more would evict what was prefetched first.
+  prefetchBytes?: number;
+  // Opens a read-only checkpoint of the DB instead: a private copy, which hard-links the DB's table files and copies
+  // the rest, so it takes little time or space. It works while another process (e.g. the app, from a share extension)
+  // has the DB open, and never contends with it. Reads see the DB as of the open, writes throw. Each read-only open
+  // gets its own checkpoint, which is deleted when it's closed.
+  readOnly?: boolean;
+  // Stores values of this many bytes or more (as encoded, e.g. attachments or long message bodies) in append-only blob
+  // files next to LevelDB's own, and only a small pointer to them in LevelDB, so that compactions don't rewrite them
+  // again and again. Reads return the values pointed to, iterators included. Call collectBlobGarbage() now and then to
+  // reclaim the space of the values deleted or overwritten since. Values already in blob files are read from them
+  // whether this is set or not. Defaults to 0: values are all stored in LevelDB.
+  blobThreshold?: number;
+}
+
+// An element of a tuple key, see LevelDB.encodeKey().
+export type LevelDBKeyPart =
+  | null
+  | boolean
+  | number
+  | string
+  | ArrayBuffer
+  | LevelDBKeyPart[];
+
+// Keys are raw bytes: strings are UTF-8 encoded, and tuples are encoded with LevelDB.encodeKey().
+export type LevelDBKey = ArrayBuffer | string | LevelDBKeyPart[];
+
+export interface LevelDBScanOptions {
+  // The maximum number of entries to return. Defaults to all of them.
+  limit?: number;
+  // Returns the entries in descending key order, e.g. the latest messages of a thread first. Defaults to false.
+  reverse?: boolean;
+  // How to return the keys: as ArrayBuffers, as UTF-8 strings, or as tuples decoded with LevelDB.decodeKey(). Defaults
+  // to 'buffer'.
+  keys?: 'buffer' | 'string' | 'tuple';
+}
+
+export interface LevelDBWriteOptions {
+  // If true, the write is flushed from the OS buffer cache (fsync) before it returns, so that it survives a machine
+  // crash. Otherwise, it only survives a process crash. Sync writes are much slower; concurrent sync writes (e.g. from
+  // several runtimes) share a single fsync.
+  sync?: boolean;
+}
+
+// An operation of LevelDB.update(), on the current value of a key (undefined if it's missing):
+// - set: replaces it.
+// - inc: adds to it, which must be a number.
+// - push: appends an element to it, which must be an array.
+// - merge: assigns the given properties to it, which must be an object.
+export type LevelDBUpdate =
+  | { set: any }
+  | { inc: number }
+  | { push: any }
+  | { merge: Record<string, any> };
+
+export interface LevelDBPutOptions extends LevelDBWriteOptions {
+  // Expire the written values after this many milliseconds: get(), getAllObjects() and scanPrefix() then treat them as
+  // missing, and sweepExpired() deletes them. The raw readers (getStr(), iterators...) still see them until then, with
+  // a 10-byte header in front of the msgpack value.
+  ttlMs?: number;
+}
+
 export interface LevelDBI {
   // Close this ref to LevelDB.
   close(): void;
@@ -73,11 +176,11 @@ export interface LevelDBI {
   closed(): boolean;
 
   // Set the database entry for "k" to "v".  Returns OK on success, throws an exception on error.
-  put(k: ArrayBuffer | string, v: any): void;
+  put(k: ArrayBuffer | string, v: any, opts?: LevelDBWriteOptions): void;
 
   // Remove the database entry (if any) for "key". Throws an exception on error.
   // It is not an error if "key" did not exist in the database.
-  delete(k: ArrayBuffer | string): void;
+  delete(k: ArrayBuffer | string, opts?: LevelDBWriteOptions): void;
 
   // Returns the corresponding value for "key", if the database contains it; returns null otherwise.
   // Throws an exception if there is an error.
@@ -104,6 +207,36 @@ export interface LevelDBI {
   newIterator(): LevelDBIteratorI;
 }
 
+// A file mapped into memory, for reading large files in chunks without reopening them for every chunk.
+export interface LevelDBFileReader {
+  // The size of the file in bytes.
+  readonly size: number;
+
+  // Returns `len` bytes from offset `pos`. Throws if that's past the end of the file. Depending on the JS runtime, this
+  // may be a view of the mapped file rather than a copy: treat it as read-only.
+  read(pos: number, len: number): ArrayBuffer;
+
+  // Unmaps the file. Buffers returned by read() stay valid.
+  close(): void;
+}
+
+// A batch of writes, built natively with LevelDB.newWriteBatch() and committed atomically with LevelDB.write(). Each
+// operation returns the batch, for chaining. Operations apply in order.
+export interface LevelDBWriteBatch {
+  // Writes `v`, encoded like LevelDB.put() does.
+  put(k: LevelDBKey, v: any, opts?: { ttlMs?: number }): LevelDBWriteBatch;
+  // Writes `v` as is: an ArrayBuffer, or a string as UTF-8. Read it back with getStr() or an iterator. Throws if it
+  // starts with the byte 0xc1, which marks the headers that the DB adds to values (see LevelDBPutOptions.ttlMs).
+  putRaw(k: LevelDBKey, v: ArrayBuffer | string): LevelDBWriteBatch;
+  delete(k: LevelDBKey): LevelDBWriteBatch;
+  // Deletes the keys in [gte, lt), including those put earlier in the batch. LevelDB has no range deletes: the keys
+  // are looked up and deleted one by one when the batch is committed, with other writes held off meanwhile.
+  deleteRange(gte: LevelDBKey, lt: LevelDBKey): LevelDBWriteBatch;
+  clear(): LevelDBWriteBatch;
+  // The size of the batch in bytes, not counting the keys that range deletes expand to.
+  approximateSize(): number;
+}
+
 export class LevelDBIterator implements LevelDBIteratorI {
   private ref: number;
 
@@ -121,7 +254,7 @@ export class LevelDBIterator implements LevelDBIteratorI {
     return this;
   }
 
-  seek(target: ArrayBuffer | string): LevelDBIterator {
+  seek(target: LevelDBKey): LevelDBIterator {
     g.leveldbIteratorSeek(this.ref, target);
     return this;
   }
@@ -165,26 +298,80 @@ export class LevelDB implements LevelDBI {
   // Note that when editing this file, this won't work, as RN will reload it and the openPathRefs
   // will be lost.
   private static openPathRefs: { [name: string]: undefined | number } = {};
+  // Read-only DBs aren't shared, each has its own checkpoint.
+  private static readOnlyRefs = new Set<number>();
   private ref: undefined | number;
 
-  constructor(name: string, createIfMissing: boolean, errorIfExists: boolean) {
+  constructor(
+    name: string,
+    createIfMissing: boolean,
+    errorIfExists: boolean,
+    options?: LevelDBOpenOptions
+  ) {
     if (nativeModuleInitError) {
       throw new Error(nativeModuleInitError);
     }
 
-    if (LevelDB.openPathRefs[name] !== undefined) {
+    if (options?.readOnly) {
+      const ref: number = g.leveldbOpen(name, false, false, options);
+      LevelDB.readOnlyRefs.add(ref);
+      this.ref = ref;
+    } else if (LevelDB.openPathRefs[name] !== undefined) {
       this.ref = LevelDB.openPathRefs[name];
     } else {
       LevelDB.openPathRefs[name] = this.ref = g.leveldbOpen(
         name,
         createIfMissing,
-        errorIfExists
+        errorIfExists,
+        options
+      );
+    }
+  }
+
+  // Like the constructor, but opens the DB on a native thread, so that the JS thread never waits on LevelDB's
+  // recovery, which replays the log left by the last session: that can take seconds after an unclean shutdown. Opening
+  // a name while it's being opened waits for that open and shares the DB, so concurrent calls (and constructor calls,
+  // which block until then) are queued behind the first one rather than failing on the DB's lock.
+  static async openAsync(
+    name: string,
+    createIfMissing: boolean,
+    errorIfExists: boolean,
+    options?: LevelDBOpenOptions
+  ): Promise<LevelDB> {
+    if (nativeModuleInitError) {
+      throw new Error(nativeModuleInitError);
+    }
+
+    if (options?.readOnly) {
+      // Not through the constructor, which would open another checkpoint.
+      const ref: number = await g.leveldbOpenAsync(name, false, false, options);
+      const db = Object.create(LevelDB.prototype) as LevelDB;
+      LevelDB.readOnlyRefs.add(ref);
+      db.ref = ref;
+      return db;
+    }
+    if (LevelDB.openPathRefs[name] === undefined) {
+      const ref = await g.leveldbOpenAsync(
+        name,
+        createIfMissing,
+        errorIfExists,
+        options
       );
+      if (LevelDB.openPathRefs[name] === undefined) {
+        LevelDB.openPathRefs[name] = ref;
+      } else {
+        // Opened by another call in the meantime: share its ref, like the constructor does.
+        g.leveldbClose(ref);
+      }
     }
+    return new LevelDB(name, createIfMissing, errorIfExists, options);
   }
 
   close() {
     g.leveldbClose(this.ref);
+    if (this.ref !== undefined) {
+      LevelDB.readOnlyRefs.delete(this.ref);
+    }
     for (const name in LevelDB.openPathRefs) {
       if (LevelDB.openPathRefs[name] === this.ref) {
         delete LevelDB.openPathRefs[name];
@@ -196,15 +383,36 @@ export class LevelDB implements LevelDBI {
   closed(): boolean {
     return (
       this.ref === undefined ||
-      !Object.values(LevelDB.openPathRefs).includes(this.ref)
+      (!LevelDB.readOnlyRefs.has(this.ref) &&
+        !Object.values(LevelDB.openPathRefs).includes(this.ref))
     );
   }
 
-  put(k: ArrayBuffer | string, v: any) {
-    g.leveldbPut(this.ref, k, v);
+  put(k: LevelDBKey, v: any, opts?: LevelDBPutOptions) {
+    g.leveldbPut(this.ref, k, v, opts?.sync, opts?.ttlMs);
+  }
+
+  // Applies `op` to the value of `k` natively and returns the new value, e.g. update(k, {inc: 1}) for a counter. Other
+  // writes through this DB, from any runtime, wait until it's done, so concurrent updates don't lose each other's
+  // changes. The value keeps its TTL, if any.
+  update(k: LevelDBKey, op: LevelDBUpdate, opts?: LevelDBWriteOptions): any {
+    return g.leveldbUpdate(this.ref, k, op, opts?.sync);
   }
 
-  get(k: string | ArrayBuffer) {
+  // Writes `value` to `k` only if it currently holds `expected`, atomically like update(). Values are compared by
+  // their encoding, i.e. deeply, with object properties in the same order. undefined stands for a missing value:
+  // cas(k, undefined, v) creates `k` only if it doesn't exist, and cas(k, v, undefined) deletes it only if it holds
+  // `v`. Returns whether the value was written.
+  cas(
+    k: LevelDBKey,
+    expected: any,
+    value: any,
+    opts?: LevelDBWriteOptions
+  ): boolean {
+    return g.leveldbCas(this.ref, k, expected, value, opts?.sync);
+  }
+
+  get(k: LevelDBKey) {
     return g.leveldbGet(this.ref, k);
   }
 
@@ -212,11 +420,11 @@ export class LevelDB implements LevelDBI {
     g.leveldbClear(this.ref);
   }
 
-  delete(k: ArrayBuffer | string) {
-    g.leveldbDelete(this.ref, k);
+  delete(k: LevelDBKey, opts?: LevelDBWriteOptions) {
+    g.leveldbDelete(this.ref, k, opts?.sync);
   }
   
-  getStr(k: ArrayBuffer | string): null | string {
+  getStr(k: LevelDBKey): null | string {
     return g.leveldbGetStr(this.ref, k);
   }
   
@@ -228,8 +436,148 @@ export class LevelDB implements LevelDBI {
     return g.leveldbGetAllObjects(this.ref);
   }
 
-  batchObjects(record: Record<string, any>, keysToDelete: string[] = []) {
-    return g.leveldbBatchObjects(this.ref, record, keysToDelete);
+  // Like getAllObjects(), optionally over the keys in [gte, lt) only, but reads and decodes the values on native
+  // threads, in parallel for large DBs: the JS thread only creates the resulting objects. Use it to load a whole DB on
+  // startup.
+  getAllObjectsAsync(
+    opts: { gte?: LevelDBKey; lt?: LevelDBKey } = {}
+  ): Promise<Record<string, any>> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.getAllObjectsAsync: could not read, the DB was closed!'
+        )
+      );
+    }
+    return g.leveldbGetAllObjectsAsync(this.ref, opts.gte, opts.lt);
+  }
+
+  // Returns the [key, value] entries whose keys start with `prefix`, in key order, with values decoded like get() does.
+  // The scan is bounded natively and the entries returned in a single call, rather than stepping an iterator and
+  // checking each key in JS. A tuple prefix matches all keys that extend it, e.g. ['thread', id] matches
+  // ['thread', id, ts]. Only supported on DBs with the 'bytewise' comparator.
+  scanPrefix(
+    prefix: LevelDBKey,
+    opts?: LevelDBScanOptions
+  ): Array<[ArrayBuffer | string | LevelDBKeyPart[], any]> {
+    return g.leveldbScanPrefix(
+      this.ref,
+      prefix,
+      opts?.limit ?? Infinity,
+      opts?.reverse ?? false,
+      opts?.keys ?? 'buffer'
+    );
+  }
+
+  // Calls `callback` with the keys in [gte, lt) (all keys by default) changed by writes to this DB, from any runtime,
+  // including deletes and clear(). Changes are coalesced: the callback runs at most once per turn of the JS event loop,
+  // with each changed key once. Returns a function that stops watching.
+  watch(
+    range: {
+      gte?: LevelDBKey;
+      lt?: LevelDBKey;
+      keys?: LevelDBScanOptions['keys'];
+    },
+    callback: (keys: Array<ArrayBuffer | string | LevelDBKeyPart[]>) => void
+  ): () => void {
+    const ref = this.ref;
+    const id = g.leveldbWatch(
+      ref,
+      range.gte,
+      range.lt,
+      range.keys ?? 'buffer',
+      callback
+    );
+    // Closing the DB in this runtime drops its watches: unwatching then does nothing.
+    return () => {
+      g.leveldbUnwatch(ref, id);
+    };
+  }
+
+  // Writes keys[i] => values[i] for each i in a single atomic batch, with a single call into native code. Values can be:
+  // - an array of values, encoded like put() does.
+  // - a Float64Array of numbers, read directly from the typed array, e.g. for time series. They read back as numbers.
+  // - a Uint8Array holding the raw values back to back, the i-th one being the bytes in
+  //   [opts.offsets[i], opts.offsets[i + 1]). They're stored as is, read them back with getStr() or an iterator. Like
+  //   with LevelDBWriteBatch.putRaw(), none may start with the byte 0xc1. They can't expire: opts.ttlMs is rejected.
+  putMany(
+    keys: LevelDBKey[],
+    values: any[] | Float64Array | Uint8Array,
+    opts?: LevelDBPutOptions & { offsets?: Uint32Array }
+  ) {
+    g.leveldbPutMany(
+      this.ref,
+      keys,
+      values,
+      opts?.offsets,
+      opts?.sync,
+      opts?.ttlMs
+    );
+  }
+
+  // Commits `batch` atomically. The batch is left as is, it can be cleared and reused.
+  write(batch: LevelDBWriteBatch, opts?: LevelDBWriteOptions) {
+    g.leveldbWrite(this.ref, batch, opts?.sync);
+  }
+
+  batchObjects(
+    record: Record<string, any>,
+    keysToDelete: LevelDBKey[] = [],
+    opts?: LevelDBPutOptions
+  ) {
+    return g.leveldbBatchObjects(
+      this.ref,
+      record,
+      keysToDelete,
+      opts?.sync,
+      opts?.ttlMs
+    );
+  }
+
+  // Like batchObjects(), but only copies the values on the JS thread: they are encoded, in parallel for large batches,
+  // and committed on native threads. Resolves once the batch is committed. Values that can't be stored (e.g. functions)
+  // throw right away, like with batchObjects().
+  batchObjectsAsync(
+    record: Record<string, any>,
+    keysToDelete: LevelDBKey[] = [],
+    opts?: LevelDBPutOptions
+  ): Promise<void> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.batchObjectsAsync: could not write, the DB was closed!'
+        )
+      );
+    }
+    return g.leveldbBatchObjectsAsync(
+      this.ref,
+      record,
+      keysToDelete,
+      opts?.sync,
+      opts?.ttlMs
+    );
+  }
+
+  // Opts into write coalescing: put(), delete() and batchObjects() are staged natively and committed together once
+  // `maxBytes` are staged, or `maxDelayMs` after the first staged write, or when flush() is called. Reads see staged
+  // writes. This multiplies the throughput of many small writes, at the cost of losing the staged writes if the app
+  // crashes before they are committed. Pass null to turn coalescing off again, which commits staged writes.
+  setWriteCoalescing(opts: null | { maxBytes?: number; maxDelayMs?: number }) {
+    if (opts === null) {
+      g.leveldbSetWriteCoalescing(this.ref, 0, 0);
+    } else {
+      g.leveldbSetWriteCoalescing(
+        this.ref,
+        opts.maxBytes ?? 1024 * 1024,
+        opts.maxDelayMs ?? 10
+      );
+    }
+  }
+
+  // Commits writes staged by write coalescing, see setWriteCoalescing(). With sync=true, one fsync makes all of them
+  // durable.
+  flush(opts?: LevelDBWriteOptions) {
+    g.leveldbFlush(this.ref, opts?.sync);
   }
 
   newIterator(): LevelDBIterator {
@@ -244,7 +592,7 @@ export class LevelDB implements LevelDBI {
   // Merges the data from another LevelDB into this one. All keys from src will be written into this LevelDB,
   // overwriting any existing values.
   // batchMerge=true will write all values from src in one transaction, thus ensuring that the dst DB is not left
-  // in a corrupt state.
+  // in a corrupt state. This holds all of src in memory: use mergeAsync() for large DBs.
   merge(src: LevelDB, batchMerge: boolean) {
     if (this.ref === undefined) {
       throw new Error(
@@ -259,6 +607,150 @@ export class LevelDB implements LevelDBI {
     g.leveldbMerge(this.ref, src.ref, batchMerge);
   }
 
+  // Like merge(), but runs off the JS thread and commits the data in chunks of about `chunkBytes`, so that memory use
+  // stays bounded however large `src` is. The merge is not atomic: if it fails, the dest DB contains a prefix of src.
+  // `onProgress` is called after each chunk, with the number of entries merged so far and an estimate of the fraction
+  // of src that they represent. Resolves with the number of entries merged.
+  mergeAsync(
+    src: LevelDB,
+    opts: {
+      chunkBytes?: number;
+      onProgress?: (entries: number, fraction: number) => void;
+    } = {}
+  ): Promise<number> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.mergeAsync: could not merge, the dest DB (this) was closed!'
+        )
+      );
+    }
+    if (src.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.mergeAsync: could not merge, the source DB was closed!'
+        )
+      );
+    }
+    return g.leveldbMergeAsync(
+      this.ref,
+      src.ref,
+      opts.chunkBytes ?? 4 * 1024 * 1024,
+      opts.onProgress
+    );
+  }
+
+  // Deletes the values that have expired (see LevelDBPutOptions.ttlMs) off the JS thread, committing the deletes in
+  // batches of about `chunkBytes`. Resolves with the number of values deleted. Expired values only take up space until
+  // then, so call this now and then, e.g. when the app starts, to keep caches bounded.
+  sweepExpired(opts: { chunkBytes?: number } = {}): Promise<number> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error('LevelDB.sweepExpired: could not sweep, the DB was closed!')
+      );
+    }
+    return g.leveldbSweepExpiredAsync(this.ref, opts.chunkBytes ?? 64 * 1024);
+  }
+
+  // Reclaims the space of the values in blob files (see LevelDBOpenOptions.blobThreshold) that were deleted or
+  // overwritten since, off the JS thread. Blob files that are at least `minGarbageRatio` garbage are deleted, after
+  // moving the values still in use out of them, with writes held off a few megabytes at a time. Files that open
+  // iterators may still read are deleted by the next call, or when the DB closes. Resolves with the number of bytes
+  // reclaimed.
+  collectBlobGarbage(opts: { minGarbageRatio?: number } = {}): Promise<number> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.collectBlobGarbage: could not collect, the DB was closed!'
+        )
+      );
+    }
+    return g.leveldbCollectBlobGarbageAsync(
+      this.ref,
+      opts.minGarbageRatio ?? 0.5
+    );
+  }
+
+  // Reopens the DB with another profile, e.g. back to 'interactive' once a bulk load is done, off the JS thread. With
+  // `compact`, the whole DB is then compacted, which pays off the compactions that the bulk load put off. Calls made
+  // meanwhile (e.g. from other runtimes) wait for the reopen. Rejects if iterators are open on the DB.
+  setProfile(
+    profile: LevelDBProfile,
+    opts: { compact?: boolean } = {}
+  ): Promise<void> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error('LevelDB.setProfile: could not reopen, the DB was closed!')
+      );
+    }
+    return g.leveldbSetProfileAsync(this.ref, profile, opts.compact ?? false);
+  }
+
+  // Streams the entries in [gte, lt) (the whole DB by default) from a consistent snapshot into a single dump file at
+  // `path`, off the JS thread. The dump can be loaded with importFrom(). Resolves with the number of entries.
+  exportTo(
+    path: string,
+    opts: {
+      gte?: LevelDBKey;
+      lt?: LevelDBKey;
+      compress?: boolean;
+    } = {}
+  ): Promise<number> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error('LevelDB.exportTo: could not export, the DB was closed!')
+      );
+    }
+    return g.leveldbExportAsync(
+      this.ref,
+      path,
+      opts.gte,
+      opts.lt,
+      opts.compress ?? false
+    );
+  }
+
+  // Makes the DB `name`, which must not exist, a copy of this DB that holds every write made before the call, off the
+  // JS thread. Writes only wait while its files are made, not while it's checked: its table files are hard-linked
+  // rather than copied, whatever the size of the DB, and so take no extra space. Only its log of recent writes and its
+  // manifest are copied. Open it like any other DB to restore from it, or to read it on the side.
+  checkpoint(name: string): Promise<void> {
+    if (this.ref === undefined) {
+      return Promise.reject(
+        new Error(
+          'LevelDB.checkpoint: could not checkpoint, the DB was closed!'
+        )
+      );
+    }
+    return g.leveldbCheckpointAsync(this.ref, name);
+  }
+
+  // Opens (creating it if needed) the DB `name` and streams the entries of the dump file at `path`, written by
+  // exportTo(), into it, off the JS thread. Existing entries with other keys are kept. The entries are committed in
+  // chunks of about `chunkBytes`: if the import fails, the DB may contain part of the dump.
+  static async importFrom(
+    path: string,
+    name: string,
+    opts: { chunkBytes?: number } = {}
+  ): Promise<LevelDB> {
+    const opened = LevelDB.openPathRefs[name] === undefined;
+    const db = new LevelDB(name, true, false);
+    try {
+      await g.leveldbImportAsync(
+        db.ref,
+        path,
+        opts.chunkBytes ?? 4 * 1024 * 1024
+      );
+    } catch (e) {
+      // The caller gets no handle to close it with.
+      if (opened) {
+        db.close();
+      }
+      throw e;
+    }
+    return db;
+  }
+
   static destroyDB(name: string, force?: boolean) {
     if (LevelDB.openPathRefs[name] !== undefined) {
       if (force) {
@@ -272,6 +764,26 @@ export class LevelDB implements LevelDBI {
     g.leveldbDestroy(name);
   }
 
+  // Encodes a tuple into a key that sorts bytewise in the tuple's order, element by element: e.g. ['conv', id, ts]
+  // rather than 'conv:' + id + ':' + zeroPad(ts). Encoded keys are shorter, and the encoding of a tuple's prefix is a
+  // prefix of its encoding, so all keys under ['conv', id] are a prefix scan away. Elements of different types sort by
+  // type: null, ArrayBuffers, strings, tuples, integers, other numbers, booleans. Follows FoundationDB's tuple layer.
+  // Keys can be passed as tuples directly wherever a key is expected, which encodes them the same way.
+  static encodeKey = g.leveldbEncodeKey as (
+    tuple: LevelDBKeyPart[]
+  ) => ArrayBuffer;
+
+  // Decodes a key encoded by encodeKey(), e.g. from LevelDBIterator.keyBuf().
+  static decodeKey = g.leveldbDecodeKey as (
+    key: ArrayBuffer
+  ) => LevelDBKeyPart[];
+
+  static newWriteBatch = g.leveldbNewWriteBatch as () => LevelDBWriteBatch;
+
+  static openFileReader = g.leveldbOpenFileReader as (
+    path: string
+  ) => LevelDBFileReader;
+
   static readFileToBuf = g.leveldbReadFileBuf as (
     path: string,
     pos: number,